@@ -0,0 +1,593 @@
+// Microbenchmarks for the hot paths of graph. The whole program is compiled
+// into this translation unit so the benchmarks call the real functions.
+#define GRAPH_NO_MAIN
+#include "graph.cpp"
+#include "harness.h"
+
+#include <sched.h>
+#include <algorithm>
+
+namespace
+{
+    struct BenchmarkOptions
+    {
+        unsigned int runs;
+        unsigned int warmup_runs;
+        int cpu;                 // -1: last CPU the process may run on
+        const char *output_path; // NULL: stdout
+        const char *filter;      // NULL: run everything
+    };
+    static BenchmarkOptions bench_options = {
+        .runs = 15,
+        .warmup_runs = 3,
+        .cpu = -1,
+        .output_path = NULL,
+        .filter = NULL
+    };
+
+    struct BenchmarkResult
+    {
+        std::string name;
+        size_t ops_per_run;
+        std::vector<double> ns_per_op;
+    };
+    static std::vector<BenchmarkResult> bench_results;
+
+    static inline double now_ns(void)
+    {
+        struct timespec time;
+        checkError(clock_gettime(CLOCK_MONOTONIC, &time), 0, "clock_gettime error");
+        return static_cast<double>(time.tv_sec) * 1e9 + static_cast<double>(time.tv_nsec);
+    }
+
+    static inline bool bench_selected(const std::string &name)
+    {
+        return bench_options.filter == NULL || name.find(bench_options.filter) != std::string::npos;
+    }
+
+    // setup runs untimed before every run, body performs ops_per_run operations
+    template <class Setup, class Body>
+    static void run_benchmark(const std::string &name, const size_t ops_per_run, Setup setup, Body body)
+    {
+        if(bench_selected(name) == false)
+        {
+            return;
+        }
+        BenchmarkResult result;
+        result.name = name;
+        result.ops_per_run = ops_per_run;
+        for(unsigned int run = 0; run < bench_options.warmup_runs + bench_options.runs; run++)
+        {
+            setup();
+            const double begin = now_ns();
+            body();
+            const double end = now_ns();
+            if(run >= bench_options.warmup_runs)
+            {
+                result.ns_per_op.push_back( (end - begin) / static_cast<double>(ops_per_run) );
+            }
+        }
+        fprintf(stderr, "%-40s %12.1f ns/op\n", name.c_str(), *std::min_element(result.ns_per_op.begin(), result.ns_per_op.end() ) );
+        bench_results.push_back(result);
+    }
+
+    static void no_setup(void)
+    {
+    }
+
+    static void pin_cpu(void)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        checkError(sched_getaffinity(0, sizeof(set), &set), 0, "sched_getaffinity error");
+        if(bench_options.cpu < 0)
+        {
+            for(size_t cpu = CPU_SETSIZE; cpu-- > 0; )
+            {
+                if(CPU_ISSET(cpu, &set) )
+                {
+                    bench_options.cpu = static_cast<int>(cpu);
+                    break;
+                }
+            }
+        }
+        CPU_ZERO(&set);
+        CPU_SET(static_cast<size_t>(bench_options.cpu), &set);
+        checkError(sched_setaffinity(0, sizeof(set), &set), 0, "sched_setaffinity error");
+    }
+
+    // fills both snapshot copies, the benchmarks run single-threaded
+    static void fill_stores(const size_t samples)
+    {
+        snapshots_init();
+        for(DataModel &model : snapshots.models)
+        {
+            for(size_t i = 0; i < samples; i++)
+            {
+                const double value = sin(static_cast<double>(i) * 0.01) * 2.0 + 2.0;
+                series_store_append(model.count_mode, CountModeChannels::CONCENTRATION, value, static_cast<double>(i), 0);
+                for(size_t channel = 0; channel < FitTestModeChannels::CHANNEL_COUNT; channel++)
+                {
+                    series_store_append(model.fit_test_mode, channel, value, static_cast<double>(i), 0);
+                }
+            }
+        }
+    }
+
+    static void bench_parse(void)
+    {
+        static const struct
+        {
+            const char *name;
+            const char *line;
+        } records[] = {
+            {"parse/count", "Conc. 1234 #/cc\r\n"},
+            {"parse/mask", "Mask 12.5 #/cc\r\n"},
+            {"parse/ambient", "Ambient 3400 #/cc\r\n"},
+            {"parse/fit_factor_pass", "FF 1 200 PASS\r\n"},
+            {"parse/fit_factor_fail", "FF 2 20 FAIL\r\n"},
+            {"parse/unmatched", "Sample tube\r\n"}
+        };
+        constexpr const size_t ops = 100000;
+        for(const auto &record : records)
+        {
+            const char *const line = record.line;
+            run_benchmark(record.name, ops, snapshots_init, [line](){
+                for(size_t i = 0; i < ops; i++)
+                {
+                    ModelOp op;
+                    op.reset = false;
+                    if(parse_live_record<CountModeChannels>(line, static_cast<double>(i), op.record) == true ||
+                        parse_live_record<FitTestModeChannels>(line, static_cast<double>(i), op.record) == true)
+                    {
+                        model_apply(snapshots.models[0], op);
+                    }
+                }
+            });
+        }
+    }
+
+    static void bench_queue(void)
+    {
+        constexpr const size_t ops = 100000;
+        LiveRecord record;
+        memset(&record, 0, sizeof(record) );
+        const auto pop_all = [](){
+            const std::lock_guard<std::mutex> lock_mutex(ingest_queue.queue_mutex);
+            while(ingest_queue.record_queue.empty() == false)
+            {
+                ingest_queue.record_queue.pop();
+            }
+        };
+        options.ingest_queue_records = ops;
+        run_benchmark("queue/push_pop", ops, no_setup, [&record](){
+            for(size_t i = 0; i < ops; i++)
+            {
+                ingest_queue_push(record);
+                const std::lock_guard<std::mutex> lock_mutex(ingest_queue.queue_mutex);
+                record = ingest_queue.record_queue.front().record;
+                ingest_queue.record_queue.pop();
+            }
+        });
+        run_benchmark("queue/push_then_drain", ops, no_setup, [&record](){
+            for(size_t i = 0; i < ops; i++)
+            {
+                ingest_queue_push(record);
+            }
+            const std::lock_guard<std::mutex> lock_mutex(ingest_queue.queue_mutex);
+            for(size_t i = 0; i < ops; i++)
+            {
+                record = ingest_queue.record_queue.front().record;
+                ingest_queue.record_queue.pop();
+            }
+        });
+
+        // pushes into a full queue
+        options.ingest_queue_records = 1024;
+        const auto fill = [&record, &pop_all](){
+            pop_all();
+            for(size_t i = 0; i < options.ingest_queue_records; i++)
+            {
+                ingest_queue_push(record);
+            }
+        };
+        for(const IngestPolicy policy : {IngestPolicy::DROP_OLDEST, IngestPolicy::COALESCE})
+        {
+            options.ingest_policy = policy;
+            run_benchmark( (policy == IngestPolicy::DROP_OLDEST) ? "queue/full_drop_oldest" : "queue/full_coalesce", ops, fill, [&record](){
+                for(size_t i = 0; i < ops; i++)
+                {
+                    ingest_queue_push(record);
+                }
+            });
+        }
+        pop_all();
+    }
+
+    // per-record writes as the serial thread used to do them against the
+    // batched writes of the log thread, into a scratch file on /tmp
+    static void bench_write(void)
+    {
+        char path[] = "/tmp/graph_bench_XXXXXX";
+        const int fd = mkstemp(path);
+        checkError2(fd, -1, "mkstemp error");
+        checkError(unlink(path), 0, "unlink error");
+
+        static const char prefix[] = "      1234.567890123: ";
+        static const char line[] = "Conc. 1234 #/cc\r\n";
+        constexpr const size_t ops = 20000;
+        const auto rewind_file = [fd](){
+            checkError(ftruncate(fd, 0), 0, "ftruncate error");
+            checkError2(lseek(fd, 0, SEEK_SET), static_cast<off_t>(-1), "lseek error");
+        };
+        run_benchmark("write/per_record", ops, rewind_file, [fd](){
+            for(size_t i = 0; i < ops; i++)
+            {
+                writeFully(fd, prefix, sizeof(prefix) - 1);
+                writeFully(fd, line, sizeof(line) - 1);
+            }
+        });
+        for(size_t batch_records : {16UL, 256UL, 4096UL})
+        {
+            std::vector<char> batch;
+            for(size_t i = 0; i < batch_records; i++)
+            {
+                batch.insert(batch.end(), prefix, prefix + sizeof(prefix) - 1);
+                batch.insert(batch.end(), line, line + sizeof(line) - 1);
+            }
+            run_benchmark("write/batched_" + std::to_string(batch_records), ops, rewind_file, [fd, &batch, batch_records](){
+                for(size_t i = 0; i < ops; i += batch_records)
+                {
+                    writeFully(fd, batch.data(), batch.size() );
+                }
+            });
+        }
+        run_benchmark("write/log_writer_append", ops, [](){ log_writer.pending.clear(); }, [](){
+            for(size_t i = 0; i < ops; i++)
+            {
+                log_writer_append(prefix, sizeof(prefix) - 1, line, sizeof(line) - 1);
+            }
+        });
+        log_writer.pending.clear();
+        log_writer.pending.shrink_to_fit();
+        checkError(close(fd), 0, "close error");
+    }
+
+    static void bench_y_axis(void)
+    {
+        constexpr const size_t ops = 100000;
+        volatile double sink = 0.0;
+        run_benchmark("y_axis/compute_y_axis", ops, no_setup, [&sink](){
+            for(size_t i = 0; i < ops; i++)
+            {
+                double y_axis_min, y_axis_max;
+                bool default_used;
+                std::tie(y_axis_min, y_axis_max, default_used) = compute_y_axis(-1.3 + static_cast<double>(i & 7), 2.7, -3.0, 5.0);
+                sink = sink + y_axis_min + y_axis_max;
+            }
+        });
+        for(size_t samples : {1000UL, 1000000UL})
+        {
+            fill_stores(samples);
+            const SeriesStore<CountModeChannels>::Series &series = snapshots.models[0].count_mode.series[CountModeChannels::CONCENTRATION];
+            run_benchmark("y_axis/range_query_" + std::to_string(samples), ops, no_setup, [&sink, &series, samples](){
+                for(size_t i = 0; i < ops; i++)
+                {
+                    const size_t begin = (i * 7919) % samples;
+                    const std::pair<double, double> range = range_tree_query(series.tree, series.values, begin, begin + samples / 3);
+                    sink = sink + range.first + range.second;
+                }
+            });
+        }
+        snapshots_init();
+    }
+
+    // appends to one series, range tree included; after the first run the
+    // blocks come back from the pool, as they do after an 'x'
+    static void bench_series(void)
+    {
+        constexpr const size_t ops = 1000000;
+        SeriesStore<CountModeChannels> &store = snapshots.models[0].count_mode;
+        for(const bool compact : {false, true})
+        {
+            options.compact_history = compact;
+            run_benchmark(compact ? "series/append_compact" : "series/append", ops, [&store](){ series_store_reset(store); }, [&store](){
+                for(size_t i = 0; i < ops; i++)
+                {
+                    series_store_append(store, CountModeChannels::CONCENTRATION, sin(static_cast<double>(i) * 0.01), static_cast<double>(i), 0);
+                }
+            });
+            series_store_reset(store);
+        }
+        options.compact_history = false;
+        snapshots_init();
+    }
+
+    // ingest side of the snapshot buffers: log every record and publish it,
+    // applying it to both copies in turn
+    static void bench_snapshot(void)
+    {
+        constexpr const size_t ops = 100000;
+        run_benchmark("snapshot/log_publish", ops, snapshots_init, [](){
+            for(size_t i = 0; i < ops; i++)
+            {
+                ModelOp op;
+                memset(&op, 0, sizeof(op) );
+                op.record.timestamp = static_cast<double>(i);
+                op.record.value = 1.0;
+                snapshot_log(op);
+                snapshot_publish();
+            }
+        });
+        snapshots_init();
+    }
+
+    // the geometry thread's work for a frame in which every panel changed
+    static void build_all_panels(const GeometryRequest &request)
+    {
+        for(auto &mode_panels : geometry.built)
+        {
+            for(PanelGeometry &panel : mode_panels)
+            {
+                panel.version = 0;
+            }
+        }
+        build_geometry(snapshots.models[0], request, geometry.back);
+    }
+
+    // the geometry thread's work for one frame, at the default window width
+    static void bench_geometry(void)
+    {
+        constexpr const size_t frames = 50;
+        init_fake_instances(1);
+        for(size_t samples : {100UL, 10000UL, 1000000UL})
+        {
+            fill_stores(samples);
+            for(const ModeType build_mode : {ModeType::COUNT_MODE, ModeType::FIT_TEST_MODE})
+            {
+                const std::string name = std::string("geometry/") + ( (build_mode == ModeType::COUNT_MODE) ? "count_" : "fit_test_") + std::to_string(samples);
+                const GeometryRequest request = {.mode = build_mode, .view = {.zoomed = false, .x_begin = 0.0, .x_end = 0.0}, .plot_width = window.window_width * 9 / 10};
+                run_benchmark(name, frames, no_setup, [&request](){
+                    for(size_t i = 0; i < frames; i++)
+                    {
+                        build_all_panels(request);
+                    }
+                });
+            }
+        }
+        // a new ambient reading rebuilds the ambient panel only
+        {
+            const GeometryRequest request = {.mode = ModeType::FIT_TEST_MODE, .view = {.zoomed = false, .x_begin = 0.0, .x_end = 0.0}, .plot_width = window.window_width * 9 / 10};
+            fill_stores(1000000);
+            double timestamp = 1000000.0;
+            run_benchmark("geometry/fit_test_ambient_1000000", frames, [&request](){ build_all_panels(request); }, [&request, &timestamp](){
+                for(size_t i = 0; i < frames; i++)
+                {
+                    series_store_append(snapshots.models[0].fit_test_mode, FitTestModeChannels::AMBIENT, 3.0, timestamp, 0);
+                    timestamp += 1.0;
+                    build_geometry(snapshots.models[0], request, geometry.back);
+                }
+            });
+        }
+        // a strip chart of the last 10000 samples costs the same however long the history
+        options.strip_chart_samples = 10000;
+        for(size_t samples : {100000UL, 1000000UL})
+        {
+            fill_stores(samples);
+            const GeometryRequest request = {.mode = ModeType::FIT_TEST_MODE, .view = {.zoomed = false, .x_begin = 0.0, .x_end = 0.0}, .plot_width = window.window_width * 9 / 10};
+            run_benchmark("geometry/strip_fit_test_" + std::to_string(samples), frames, no_setup, [&request](){
+                for(size_t i = 0; i < frames; i++)
+                {
+                    build_all_panels(request);
+                }
+            });
+        }
+        options.strip_chart_samples = 0;
+        // the compact history decodes 16-bit codes instead of reading doubles
+        options.compact_history = true;
+        fill_stores(1000000);
+        {
+            const GeometryRequest request = {.mode = ModeType::FIT_TEST_MODE, .view = {.zoomed = false, .x_begin = 0.0, .x_end = 0.0}, .plot_width = window.window_width * 9 / 10};
+            run_benchmark("geometry/compact_fit_test_1000000", frames, no_setup, [&request](){
+                for(size_t i = 0; i < frames; i++)
+                {
+                    build_all_panels(request);
+                }
+            });
+        }
+        options.compact_history = false;
+        remove_fake_instances();
+        snapshots_init();
+    }
+
+    static void bench_semaphore_sync(void)
+    {
+        constexpr const size_t ops = 20000;
+        for(unsigned int total_instances : {1U, 4U, 16U})
+        {
+            init_fake_instances(total_instances);
+            run_benchmark("sync/y_axes_" + std::to_string(total_instances) + "_instances", ops, no_setup, [](){
+                for(size_t i = 0; i < ops; i++)
+                {
+                    double y_axis_min[FitTestModeChannels::CHANNEL_COUNT] = {3.0, -1.0, 0.0};
+                    double y_axis_max[FitTestModeChannels::CHANNEL_COUNT] = {6.0, 3.0, 3.0};
+                    const bool default_y_axis[FitTestModeChannels::CHANNEL_COUNT] = {false, false, false};
+                    synchronize_y_axes<FitTestModeChannels>(y_axis_min, y_axis_max, default_y_axis);
+                }
+            });
+            remove_fake_instances();
+        }
+    }
+
+    static void bench_live_feed(void)
+    {
+        constexpr const size_t ops = 100000;
+        LiveRecord record;
+        memset(&record, 0, sizeof(record) );
+        run_benchmark("live_feed/publish", ops, no_setup, [&record](){
+            for(size_t i = 0; i < ops; i++)
+            {
+                record.timestamp = static_cast<double>(i);
+                live_feed_publish(live_feed, record);
+            }
+        });
+    }
+
+    static constexpr const size_t RENDER_SAMPLE_COUNTS[] = {100, 10000, 1000000};
+
+    static inline std::string render_benchmark_name(const ModeType render_mode, const size_t samples)
+    {
+        return std::string("render/") + ( (render_mode == ModeType::COUNT_MODE) ? "count_" : "fit_test_") + std::to_string(samples);
+    }
+
+    // Renders display() into a hidden window; needs an X display.
+    static void bench_render(int *const argc, char *argv[])
+    {
+        // the filter matches within a name, so only the full names tell whether any is selected
+        bool selected = false;
+        for(const size_t samples : RENDER_SAMPLE_COUNTS)
+        {
+            for(const ModeType render_mode : {ModeType::COUNT_MODE, ModeType::FIT_TEST_MODE})
+            {
+                selected = selected || bench_selected(render_benchmark_name(render_mode, samples) );
+            }
+        }
+        if(selected == false)
+        {
+            return;
+        }
+        if(getenv("DISPLAY") == NULL)
+        {
+            fprintf(stderr, "DISPLAY not set, skipping render benchmarks\n");
+            return;
+        }
+        glutInit(argc, argv);
+        glutInitWindowSize(window.window_width, window.window_height);
+        create_window("Portacount benchmark");
+        glutHideWindow();
+        init_graphics();
+        init_fake_instances(1);
+
+        constexpr const size_t frames = 20;
+        for(const size_t samples : RENDER_SAMPLE_COUNTS)
+        {
+            fill_stores(samples);
+            for(const ModeType render_mode : {ModeType::COUNT_MODE, ModeType::FIT_TEST_MODE})
+            {
+                const std::string name = render_benchmark_name(render_mode, samples);
+                // display() draws the frame the geometry thread would have built
+                const auto setup = [render_mode](){
+                    mode = render_mode;
+                    geometry_request();
+                    build_geometry(snapshots.models[0], geometry.request, geometry.published);
+                    geometry.has_published = true;
+                };
+                run_benchmark(name, frames, setup, [](){
+                    for(size_t i = 0; i < frames; i++)
+                    {
+                        display();
+                        glFinish();
+                    }
+                });
+            }
+        }
+        remove_fake_instances();
+        snapshots_init();
+    }
+
+    static void write_json(FILE *const file)
+    {
+        fprintf(file, "{\n  \"cpu\": %d,\n  \"runs\": %u,\n  \"warmup_runs\": %u,\n  \"benchmarks\": [\n", bench_options.cpu, bench_options.runs, bench_options.warmup_runs);
+        for(size_t i = 0; i < bench_results.size(); i++)
+        {
+            std::vector<double> sorted = bench_results[i].ns_per_op;
+            std::sort(sorted.begin(), sorted.end() );
+            double mean = 0.0;
+            for(const double value : sorted)
+            {
+                mean += value;
+            }
+            mean /= static_cast<double>(sorted.size() );
+            double variance = 0.0;
+            for(const double value : sorted)
+            {
+                variance += (value - mean) * (value - mean);
+            }
+            variance /= static_cast<double>(sorted.size() );
+            const size_t middle = sorted.size() / 2;
+            const double median = ( (sorted.size() & 1) != 0) ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) * 0.5;
+            fprintf(file, "    {\"name\": \"%s\", \"ops_per_run\": %zu, \"min_ns\": %.3f, \"median_ns\": %.3f, \"mean_ns\": %.3f, \"max_ns\": %.3f, \"stddev_ns\": %.3f}%s\n",
+                bench_results[i].name.c_str(), bench_results[i].ops_per_run, sorted.front(), median, mean, sorted.back(), sqrt(variance),
+                (i + 1 < bench_results.size() ) ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+    }
+
+    static void parse_bench_options(const int argc, char *const argv[])
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            const char *value;
+            if(strncmp(argv[i], "--", 2) != 0)
+            {
+                continue;
+            }
+            else if( (value = option_value(argv[i], "--runs") ) != NULL)
+            {
+                bench_options.runs = static_cast<unsigned int>(parse_long_option(value, 1, 10000, "runs out of range") );
+            }
+            else if( (value = option_value(argv[i], "--warmup") ) != NULL)
+            {
+                bench_options.warmup_runs = static_cast<unsigned int>(parse_long_option(value, 0, 10000, "warmup out of range") );
+            }
+            else if( (value = option_value(argv[i], "--cpu") ) != NULL)
+            {
+                bench_options.cpu = static_cast<int>(parse_long_option(value, 0, CPU_SETSIZE - 1, "cpu out of range") );
+            }
+            else if( (value = option_value(argv[i], "--output") ) != NULL)
+            {
+                bench_options.output_path = value;
+            }
+            else if( (value = option_value(argv[i], "--filter") ) != NULL)
+            {
+                bench_options.filter = value;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown option %s\n", argv[i]);
+                exit(1);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    parse_bench_options(argc, argv);
+    pin_cpu();
+    init_private_live_feed();
+
+    bench_parse();
+    bench_queue();
+    bench_write();
+    bench_y_axis();
+    bench_series();
+    bench_snapshot();
+    bench_geometry();
+    bench_semaphore_sync();
+    bench_live_feed();
+    bench_render(&argc, argv);
+
+    FILE *file = stdout;
+    if(bench_options.output_path != NULL)
+    {
+        file = fopen(bench_options.output_path, "w");
+        checkError2(file, static_cast<FILE *>(NULL), "fopen error");
+    }
+    write_json(file);
+    if(file != stdout)
+    {
+        checkError(fclose(file), 0, "fclose error");
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "live_feed.h"
+
+// Prints the live records of a running graph instance, see live_feed.h.
+// Attaches read-only, so any number of these can run next to the instance.
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Need more arguments: <instance_index>\n");
+        return 1;
+    }
+    const long int temp_long = strtol(argv[1], NULL, 10);
+    if(temp_long < 0 || temp_long > 10000)
+    {
+        fprintf(stderr, "instance_index out of range\n");
+        return 1;
+    }
+    const unsigned int instance_index = static_cast<unsigned int>(temp_long);
+
+    static const char *const mode_names[] = {"count", "fit-test"};
+    static const char *const alarm_names[] = {"ambient low", "fit factor low"};
+    for(;;)
+    {
+        // a closed feed is about to be removed, wait for the one of the restarted instance
+        const LiveFeedHeader *header;
+        for(;;)
+        {
+            header = live_feed_attach(instance_index);
+            if(header != NULL && header->closed.load(std::memory_order_acquire) == 0)
+            {
+                break;
+            }
+            if(header != NULL)
+            {
+                live_feed_detach(header);
+            }
+            else if(errno != ENOENT)
+            {
+                perror("live_feed_attach error");
+                return 1;
+            }
+            usleep(100000);
+        }
+
+        LiveFeedCursor cursor;
+        LiveRecord record;
+        uint64_t reported_lost = 0;
+        uint32_t reported_alarms = 0;
+        live_feed_seek_oldest(header, &cursor);
+        for(;;)
+        {
+            const uint32_t alarms = header->alarm_active.load(std::memory_order_acquire);
+            for(uint32_t rule = 0; rule < LIVE_ALARM_RULE_COUNT; rule++)
+            {
+                if( ( (alarms ^ reported_alarms) & (1U << rule) ) != 0)
+                {
+                    printf("# alarm %s %s\n", alarm_names[rule], ( (alarms & (1U << rule) ) != 0) ? "raised" : "cleared");
+                }
+            }
+            reported_alarms = alarms;
+            if(live_feed_read(header, &cursor, &record) == false)
+            {
+                if(cursor.closed == true)
+                {
+                    break;
+                }
+                fflush(stdout);
+                usleep(10000);
+                continue;
+            }
+            if(cursor.lost != reported_lost)
+            {
+                printf("# overrun, %llu records lost\n", static_cast<unsigned long long int>(cursor.lost - reported_lost) );
+                reported_lost = cursor.lost;
+            }
+            printf("%llu %20.9f %s %u %g %.6f 0x%02x\n", static_cast<unsigned long long int>(record.sequence), record.timestamp,
+                (record.mode < 2) ? mode_names[record.mode] : "?", static_cast<unsigned int>(record.channel), record.reading, record.value,
+                static_cast<unsigned int>(record.flags) );
+        }
+        printf("# instance exited, waiting for it to restart\n");
+        fflush(stdout);
+        live_feed_detach(header);
+    }
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+// Merges the output files of several graph instances into one file ordered
+// by arrival time, in the format of a --fleet-record recording: every line
+// gets the index of its file after its timestamp. The files are read once,
+// front to back, with one line per file in memory, so the merge is a k-way
+// merge over a heap of the current lines.
+
+namespace
+{
+    struct MergeInput
+    {
+        FILE *file;
+        unsigned int source;
+        char *line;
+        size_t capacity;
+        ssize_t length;
+        double timestamp;
+        const char *text;        // line after the "<timestamp>: " prefix
+    };
+
+    // reads the next line of input, false at its end
+    static bool merge_input_next(MergeInput &input, double last_timestamp)
+    {
+        input.length = getline(&input.line, &input.capacity, input.file);
+        if(input.length < 0)
+        {
+            return false;
+        }
+        char *end;
+        input.timestamp = strtod(input.line, &end);
+        if(end == input.line || end[0] != ':' || end[1] != ' ')
+        {
+            // not a record of graph, keep it where it is
+            input.timestamp = last_timestamp;
+            input.text = input.line;
+            return true;
+        }
+        input.text = end + 2;
+        return true;
+    }
+
+    // orders the heap by timestamp, then by source
+    static bool merge_input_later(const MergeInput *const a, const MergeInput *const b)
+    {
+        return (a->timestamp != b->timestamp) ? (a->timestamp > b->timestamp) : (a->source > b->source);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Need more arguments: <output_file of instance 0> [<output_file of instance 1> ...]\n");
+        return 1;
+    }
+
+    static char output_buffer[1 << 20];
+    setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer) );
+
+    std::vector<MergeInput> inputs(static_cast<size_t>(argc - 1) );
+    std::vector<MergeInput *> heap;
+    for(size_t i = 0; i < inputs.size(); i++)
+    {
+        MergeInput &input = inputs[i];
+        input.file = fopen(argv[i + 1], "r");
+        if(input.file == NULL)
+        {
+            perror(argv[i + 1]);
+            return 1;
+        }
+        setvbuf(input.file, NULL, _IOFBF, 1 << 20);
+        input.source = static_cast<unsigned int>(i);
+        input.line = NULL;
+        input.capacity = 0;
+        if(merge_input_next(input, 0.0) == true)
+        {
+            heap.push_back(&input);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), merge_input_later);
+
+    while(heap.empty() == false)
+    {
+        std::pop_heap(heap.begin(), heap.end(), merge_input_later);
+        MergeInput &input = *heap.back();
+        printf("%20.9f %u: ", input.timestamp, input.source);
+        fwrite(input.text, 1, static_cast<size_t>(input.line + input.length - input.text), stdout);
+        if(input.line[input.length - 1] != '\n')
+        {
+            // torn last line of a file
+            putchar('\n');
+        }
+        if(merge_input_next(input, input.timestamp) == true)
+        {
+            std::push_heap(heap.begin(), heap.end(), merge_input_later);
+        }
+        else
+        {
+            heap.pop_back();
+        }
+    }
+
+    for(MergeInput &input : inputs)
+    {
+        free(input.line);
+        fclose(input.file);
+    }
+    if(fflush(stdout) != 0)
+    {
+        perror("fflush error");
+        return 1;
+    }
+    return 0;
+}
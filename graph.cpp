@@ -1,4 +1,8 @@
+#ifndef GRAPH_HEADLESS
+// framebuffer objects for the render quality governor
+#define GL_GLEXT_PROTOTYPES 1
 #include <GL/freeglut.h>
+#endif
 #include <stdio.h>
 #include <math.h>
 #include <fcntl.h>
@@ -12,7 +16,21 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/file.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <spawn.h>
+#include <signal.h>
+#include <netinet/in.h>
 #include <semaphore.h>
+#include <sched.h>
+#include <pthread.h>
+#include <algorithm>
 #include <limits>
 #include <vector>
 #include <utility>
@@ -22,6 +40,11 @@
 #include <deque>
 #include <mutex>
 #include <thread>
+#include <condition_variable>
+#include <chrono>
+#include "live_feed.h"
+#include "probes.h"
+#include "rollup.h"
 
 namespace
 {
@@ -88,12 +111,51 @@ namespace
         }while(remaining > 0);
     }
 
+    // Sleep of a polling loop. A stop and continue interrupts it even without
+    // a signal handler, and the loop polls again either way.
+    static inline void sleepMicroseconds(const useconds_t usec)
+    {
+        const int ret = usleep(usec);
+        if(ret == -1 && errno == EINTR)
+        {
+            return;
+        }
+        checkError(ret, 0, "usleep error");
+    }
+
+    // sem_wait is interrupted by a stop and continue even without a signal handler
+    static inline void semWaitFully(sem_t *const semaphore)
+    {
+        int ret;
+        do
+        {
+            ret = sem_wait(semaphore);
+        }while(ret == -1 && errno == EINTR);
+        checkError(ret, 0, "sem_wait error");
+    }
+
+    // CLOCK_MONOTONIC seconds, the clock of the record timestamps
+    static inline double monotonic_seconds(void)
+    {
+        struct timespec time;
+        checkError(clock_gettime(CLOCK_MONOTONIC, &time), 0, "clock_gettime error");
+        return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) * 0.000000001;
+    }
+
+    // timestamp argument of a probe, see probes.h
+    static inline uint64_t probe_ns(const double seconds)
+    {
+        return static_cast<uint64_t>(llround(seconds * 1e9) );
+    }
+
+#ifndef GRAPH_HEADLESS
     struct ViewportDimension
     {
         int window_width;
         int window_height;
     };
     static ViewportDimension window = {.window_width = 958, .window_height = 958};
+#endif
 
     struct OrthographicProjectionDimension
     {
@@ -113,6 +175,177 @@ namespace
     };
     static FileDescriptors fds;
 
+    enum class SlowClientPolicy
+    {
+        DROP_OLDEST,
+        DISCONNECT
+    };
+
+    enum class IngestPolicy
+    {
+        BLOCK,
+        DROP_OLDEST,
+        COALESCE
+    };
+
+    struct Options
+    {
+        bool append_output;          // reopen an existing output file after recovering it
+        unsigned long sync_interval_ms;
+        size_t sync_bytes;
+        size_t preallocate_bytes;
+        const char *stream_socket_path;  // NULL: no Unix socket stream server
+        unsigned int stream_port;        // 0: no TCP stream server
+        size_t stream_queue_frames;
+        SlowClientPolicy stream_policy;
+        bool realtime;               // SCHED_FIFO serial thread, locked memory
+        int realtime_priority;
+        int realtime_cpu;            // -1: no affinity
+        bool jitter_report;          // also implied by realtime
+        size_t ingest_queue_records;
+        IngestPolicy ingest_policy;
+        double alarm_ambient_min;    // #/cc, 0: rule off
+        double alarm_fit_factor_min; // 0: rule off
+        const char *alarm_hook;      // NULL: no hook command
+        unsigned long alarm_deadline_ms;
+        unsigned long alarm_hook_timeout_ms;
+        bool rollups;                // rollup sidecar files next to the output file
+        bool fleet;                  // append records to the fleet log of all instances
+        const char *fleet_record_path;   // NULL: another instance drains the fleet log
+        const char *checkpoint_path;     // NULL: no session checkpoints
+        unsigned long checkpoint_interval_ms;
+        double strip_chart_seconds;      // 0: no time window
+        size_t strip_chart_samples;      // 0: no sample window
+        double frame_budget_ms;          // 0: no render quality governor
+        int max_samples;                 // multisampling cap
+        bool full_redraw;                // no panel cache, every frame is drawn in full
+        bool compact_history;            // 16-bit quantized values and range trees
+        bool headless;                   // daemon without a window
+        bool attach;                     // viewer of a headless daemon, no serial port
+    };
+    static Options options = {
+        .append_output = false,
+        .sync_interval_ms = 500,
+        .sync_bytes = 64 * 1024,
+        .preallocate_bytes = 1024 * 1024,
+        .stream_socket_path = NULL,
+        .stream_port = 0,
+        .stream_queue_frames = 4096,
+        .stream_policy = SlowClientPolicy::DROP_OLDEST,
+        .realtime = false,
+        .realtime_priority = 50,
+        .realtime_cpu = -1,
+        .jitter_report = false,
+        .ingest_queue_records = 4096,
+        .ingest_policy = IngestPolicy::DROP_OLDEST,
+        .alarm_ambient_min = 0.0,
+        .alarm_fit_factor_min = 0.0,
+        .alarm_hook = NULL,
+        .alarm_deadline_ms = 100,
+        .alarm_hook_timeout_ms = 10000,
+        .rollups = false,
+        .fleet = false,
+        .fleet_record_path = NULL,
+        .checkpoint_path = NULL,
+        .checkpoint_interval_ms = 5000,
+        .strip_chart_seconds = 0.0,
+        .strip_chart_samples = 0,
+        .frame_budget_ms = 0.0,
+        .max_samples = SAMPLE_COUNT,
+        .full_redraw = false,
+        .compact_history = false,
+#ifdef GRAPH_HEADLESS
+        .headless = true,            // built without GL, --headless is implied
+#else
+        .headless = false,
+#endif
+        .attach = false
+    };
+
+    // Group-commit writer for the output file. The serial thread only copies
+    // records into pending; the log thread writes everything that accumulated
+    // and covers it with a single fdatasync every sync_interval_ms, or sooner
+    // once sync_bytes are waiting. A power cut loses at most one such batch.
+    struct LogWriter
+    {
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::vector<char> pending;
+        bool quit;
+        bool preallocate;            // cleared if the filesystem has no fallocate
+        off_t file_size;
+        off_t allocated_size;
+    };
+    static LogWriter log_writer;
+
+    // One stream consumer. frames is a ring of count queued frames starting
+    // at head; the first head_offset bytes of the head frame are already sent.
+    struct StreamClient
+    {
+        int fd;
+        std::vector<StreamFrame> frames;
+        size_t head;
+        size_t count;
+        size_t head_offset;
+        bool want_write;             // EPOLLOUT is armed
+        unsigned long long dropped;
+    };
+
+    // Fans the live feed out to socket clients from its own epoll thread. The
+    // serial thread only pokes event_fd; every client has a bounded queue, so
+    // a slow client costs its own records (or its connection) and nothing else.
+    struct StreamServer
+    {
+        int epoll_fd;
+        int event_fd;
+        int unix_fd;
+        int tcp_fd;
+        std::atomic<bool> quit;
+        std::vector<StreamClient *> clients;
+        LiveFeedCursor cursor;
+    };
+    static StreamServer stream_server;
+
+    // One raised alarm on its way to the alarm thread. Latencies are seconds
+    // from the arrival of the record that raised it.
+    struct AlarmEvent
+    {
+        uint8_t rule;                // LiveAlarmRule
+        double reading;
+        double timestamp;
+        double flag_latency;         // until the live feed flag was set
+    };
+
+    struct LatencyStats
+    {
+        unsigned long long count;
+        double sum;
+        double max;
+    };
+
+    // Threshold alarms. The serial thread evaluates the rules on every parsed
+    // record; raising an alarm only sets the live feed flag, queues an event
+    // and pokes event_fd. The alarm thread rings the bell, prints it and runs
+    // the hook, so a slow hook never delays acquisition.
+    struct AlarmState
+    {
+        int event_fd;
+        bool active[LIVE_ALARM_RULE_COUNT];  // serial thread only
+        std::mutex mutex;
+        std::vector<AlarmEvent> pending;
+        std::atomic<bool> quit;
+        // alarm thread only
+        pid_t hook_pid;              // 0: no hook running
+        double hook_started;
+        LatencyStats flag_latency;
+        LatencyStats hook_latency;
+        unsigned long long late;     // hooks started after the deadline
+        unsigned long long suppressed; // alarms raised while a hook still ran
+        unsigned long long killed;   // hooks killed after the hook timeout
+    };
+    static AlarmState alarm_state;
+    static const char *const alarm_names[LIVE_ALARM_RULE_COUNT] = {"ambient-low", "fit-factor-low"};
+
     enum class ModeType
     {
         COUNT_MODE,
@@ -120,43 +353,477 @@ namespace
     };
     static ModeType mode = ModeType::COUNT_MODE;
 
-    struct CountModeData
+    // Series data is kept in fixed-size, cache-aligned blocks, so an append
+    // never moves or copies what is already stored and element addresses
+    // stay put. Blocks are carved from arenas of SERIES_ARENA_BLOCKS and go
+    // to a free list when a history is cleared, for the next one to reuse;
+    // arenas are never given back. Like every model change, ingest thread only.
+    static constexpr const size_t SERIES_BLOCK_BYTES = 4096;
+    static constexpr const size_t SERIES_ARENA_BLOCKS = 64;
+    static constexpr const size_t CACHE_LINE_BYTES = 64;
+    struct SeriesBlockPool
+    {
+        std::vector<void *> free_blocks;
+        size_t arena_count;
+    };
+    static SeriesBlockPool series_block_pool;
+
+    // Append-only sequence in pool blocks, element i is in blocks[i / BLOCK_ELEMENTS].
+    // Only the directory of block pointers ever reallocates.
+    template <class T>
+    struct SegmentedVector
+    {
+        static constexpr const size_t BLOCK_ELEMENTS = SERIES_BLOCK_BYTES / sizeof(T);
+        static_assert(SERIES_BLOCK_BYTES % sizeof(T) == 0, "Series elements must tile a block");
+        std::vector<T *> blocks;
+        size_t size;
+    };
+
+    // Compact history (--compact-history): log10 values as 16-bit codes in
+    // pool blocks, value = base + code * scale with the base and scale of the
+    // block. The scale is a power of two and the base a multiple of it, so
+    // every decade boundary in the range of a block is exact. A block starts
+    // at QUANTIZED_MIN_SCALE, 2^-16 decades; a value outside its range makes
+    // it re-encode its codes at twice the scale until the value fits, which
+    // moves them by less than the new step. The rounding of a vector says how
+    // values between codes are stored: values to the nearest code, range tree
+    // minima down and maxima up, so a range query may come out wider than the
+    // samples but cuts off none of them by more than a step of its block.
+    static constexpr const double QUANTIZED_MIN_SCALE = 1.0 / 65536.0;
+    static constexpr const double QUANTIZED_MAX_CODE = 65535.0;
+    static constexpr const double QUANTIZED_VALUE_LIMIT = 120.0;  // |log10| clamped to this, within 65535 codes at the coarsest scale
+    enum QuantizeRounding : uint8_t
+    {
+        QUANTIZE_NEAREST,
+        QUANTIZE_DOWN,
+        QUANTIZE_UP
+    };
+    struct QuantizedBlock
+    {
+        double base;
+        double scale;
+        uint16_t codes[(SERIES_BLOCK_BYTES - 2 * sizeof(double) ) / sizeof(uint16_t)];
+    };
+    static_assert(sizeof(QuantizedBlock) == SERIES_BLOCK_BYTES, "Unexpected QuantizedBlock size");
+    struct QuantizedVector
+    {
+        static constexpr const size_t BLOCK_ELEMENTS = sizeof(QuantizedBlock::codes) / sizeof(uint16_t);
+        std::vector<QuantizedBlock *> blocks;
+        size_t size;
+        QuantizeRounding rounding;
+    };
+
+    // Range min/max index over a series, maintained incrementally on append.
+    // Level 0 is the series itself, so only the internal levels are stored:
+    // node i of level_min[k] covers nodes 2i and 2i+1 of the level below.
+    // Levels may be partially filled, so an append touches one node per level
+    // and never rebuilds, and a query walks O(log n) nodes. Vector is
+    // SegmentedVector<double> or, for a compact history, QuantizedVector.
+    template <class Vector>
+    struct RangeMinMaxTree
+    {
+        std::vector<Vector> level_min;
+        std::vector<Vector> level_max;
+    };
+
+    // Strip-chart mode (--strip-chart-seconds, --strip-chart-samples): instead
+    // of the history, a series keeps only the samples inside the window, in
+    // a ring that grows to the largest window seen and is then reused. The
+    // monotonic queues hold the positions of the window's samples in
+    // increasing (min_queue) and decreasing (max_queue) order of value, so
+    // their fronts are the window min and max after O(1) amortized work per
+    // sample. Positions count the samples since the last reset; position p
+    // is at ring index p & (capacity - 1).
+    static constexpr const size_t STRIP_INITIAL_CAPACITY = 1024;
+    struct MonotonicQueue
+    {
+        std::vector<uint64_t> positions;     // ring, as large as the sample ring
+        uint64_t begin;
+        uint64_t end;
+    };
+    struct StripSeries
+    {
+        std::vector<double> values;
+        std::vector<double> timestamps;
+        std::vector<uint8_t> flags;
+        uint64_t begin;                      // oldest sample in the window
+        uint64_t end;                        // one past the newest
+        MonotonicQueue min_queue;
+        MonotonicQueue max_queue;
+    };
+
+    // Visible x range in sample indices. When not zoomed the view follows the
+    // whole history, [0, x_axis_max].
+    struct ViewState
+    {
+        bool zoomed;
+        double x_begin;
+        double x_end;
+    };
+
+    static constexpr const double MIN_VIEW_WIDTH = 4.0;
+    static constexpr const double ZOOM_STEP = 1.25;
+    static constexpr const double PAN_STEP = 0.1;
+
+    enum SampleFlag : uint8_t
+    {
+        SAMPLE_FLAG_ZERO_CLAMPED = 0x01,
+        SAMPLE_FLAG_PASS = 0x02,
+        SAMPLE_FLAG_FAIL = 0x04
+    };
+
+    struct RecordFormat
+    {
+        const char *scan_format; // sscanf format with a single %lf conversion followed by a final %n
+        uint8_t flags;           // flags stored with samples matched by this format
+    };
+
+    struct ChannelDescriptor
+    {
+        const char *label;
+        double label_y;          // y offset of the axis label from the bottom of the panel
+        double default_y_axis_min;
+        double default_y_axis_max;
+        bool clamp_zero;         // change 0.0 to 0.001 to avoid log(0)
+        RecordFormat formats[2]; // unused entries have a NULL scan_format
+    };
+
+    // A channel set is a traits class: the Channel enum gives every series its
+    // slot and its panel (bottom to top), descriptors[] says how to parse and
+    // label it, and the panel geometry is shared by all channels of the set.
+    // Adding a channel only needs an enum entry and a descriptor.
+    struct CountModeChannels
+    {
+        enum Channel : size_t
+        {
+            CONCENTRATION,
+            CHANNEL_COUNT
+        };
+        static constexpr const ModeType MODE = ModeType::COUNT_MODE;
+        static constexpr const double PANEL_HEIGHT = 9.9;
+        static constexpr const double GRID_HEIGHT = 9.3;
+        static constexpr const double LINE_HEIGHT = 9.5;
+        static const ChannelDescriptor descriptors[CHANNEL_COUNT];
+    };
+    const ChannelDescriptor CountModeChannels::descriptors[CountModeChannels::CHANNEL_COUNT] = {
+        {.label = "Count", .label_y = 4.5, .default_y_axis_min = -3.0, .default_y_axis_max = 5.0, .clamp_zero = true,
+            .formats = {{.scan_format = "Conc. %lf #/cc%n", .flags = 0}, {.scan_format = NULL, .flags = 0}}}
+    };
+
+    struct FitTestModeChannels
+    {
+        enum Channel : size_t
+        {
+            AMBIENT,
+            SAMPLE,
+            FIT_FACTOR,
+            CHANNEL_COUNT
+        };
+        static constexpr const ModeType MODE = ModeType::FIT_TEST_MODE;
+        static constexpr const double PANEL_HEIGHT = 3.3;
+        static constexpr const double GRID_HEIGHT = 2.8;
+        static constexpr const double LINE_HEIGHT = 2.8;
+        static const ChannelDescriptor descriptors[CHANNEL_COUNT];
+    };
+    const ChannelDescriptor FitTestModeChannels::descriptors[FitTestModeChannels::CHANNEL_COUNT] = {
+        {.label = "Ambient", .label_y = 1.3, .default_y_axis_min = 3.0, .default_y_axis_max = 6.0, .clamp_zero = false,
+            .formats = {{.scan_format = "Ambient %lf #/cc%n", .flags = 0}, {.scan_format = NULL, .flags = 0}}},
+        {.label = "Mask", .label_y = 1.5, .default_y_axis_min = -1.0, .default_y_axis_max = 3.0, .clamp_zero = false,
+            .formats = {{.scan_format = "Mask %lf #/cc%n", .flags = 0}, {.scan_format = NULL, .flags = 0}}},
+        {.label = "Fit factor", .label_y = 1.0, .default_y_axis_min = 0.0, .default_y_axis_max = 3.0, .clamp_zero = false,
+            .formats = {{.scan_format = "FF %*u %lf PASS%n", .flags = SAMPLE_FLAG_PASS}, {.scan_format = "FF %*u %lf FAIL%n", .flags = SAMPLE_FLAG_FAIL}}}
+    };
+
+    static constexpr const size_t MAX_CHANNEL_COUNT = (static_cast<size_t>(CountModeChannels::CHANNEL_COUNT) > static_cast<size_t>(FitTestModeChannels::CHANNEL_COUNT) ) ?
+        static_cast<size_t>(CountModeChannels::CHANNEL_COUNT) : static_cast<size_t>(FitTestModeChannels::CHANNEL_COUNT);
+    static constexpr const size_t MODE_COUNT = 2;
+
+    // Structure-of-arrays history of one channel set. All channels of a store
+    // share the x-axis.
+    template <class Channels>
+    struct SeriesStore
+    {
+        struct Series
+        {
+            SegmentedVector<double> values;     // log10 of the reading
+            SegmentedVector<double> timestamps; // CLOCK_MONOTONIC seconds
+            SegmentedVector<uint8_t> flags;     // SampleFlag bits
+            RangeMinMaxTree<SegmentedVector<double>> tree;
+            QuantizedVector compact_values;     // --compact-history: instead of values and tree
+            RangeMinMaxTree<QuantizedVector> compact_tree;
+            StripSeries strip;                  // strip-chart mode only, the fields above stay empty
+        };
+        double x_axis_max;
+        unsigned long long generation;      // bumped by every reset
+        Series series[Channels::CHANNEL_COUNT];
+    };
+
+    // everything parsed so far, for both modes whichever one is displayed
+    struct DataModel
+    {
+        SeriesStore<CountModeChannels> count_mode;
+        SeriesStore<FitTestModeChannels> fit_test_mode;
+    };
+
+    // one change to the data model; a reset clears the store of record.mode
+    struct ModelOp
+    {
+        bool reset;
+        LiveRecord record;
+    };
+
+    // Left-right double buffer of the data model. The ingest thread applies
+    // new ops to the copy the GUI is not reading and then flips active; log
+    // holds the ops the other copy still lacks. A copy with readers is never
+    // written and never waited for, its ops stay in the log until the GUI
+    // lets go of it, so a slow frame only delays when new data shows up.
+    struct SnapshotBuffers
+    {
+        DataModel models[2];
+        std::atomic<unsigned int> active;
+        std::atomic<unsigned int> readers[2];
+        std::atomic<unsigned long long> version;  // bumped on every flip
+        unsigned long long applied[2];            // ops applied to each copy
+        unsigned long long log_begin;             // op number of log.front()
+        std::deque<ModelOp> log;
+        std::atomic<bool> reset_requested[MODE_COUNT];
+        std::atomic<double> pending_since;        // arrival of the oldest record not in the active copy, 0: none
+    };
+    static SnapshotBuffers snapshots;
+
+    // GUI state, one view per mode
+    static ViewState views[MODE_COUNT];
+
+    struct TextLabel
+    {
+        char text[32];
+        float scale;
+        float x;
+        float y;
+        bool vertical;
+    };
+
+    // Ready-to-draw geometry of one panel in projection coordinates. lines
+    // are GL_LINES vertex pairs of the grids, points the samples, both x, y
+    // per vertex, as GL_FLOAT so that a headless build builds it without GL.
+    struct PanelGeometry
+    {
+        std::vector<float> lines;
+        std::vector<float> points;
+        std::vector<TextLabel> labels;
+        unsigned long long version;             // of the build, unique over all panels, 0: none
+    };
+
+    // What a panel was built from besides its samples, which only change by
+    // appending or by a reset of the store. The geometry thread rebuilds a
+    // panel only when its key changed, so a record of one channel costs the
+    // build of one panel.
+    struct PanelKey
+    {
+        unsigned long long generation;          // of the store
+        size_t first_index;                     // visible samples of the history
+        size_t last_index;
+        uint64_t strip_begin;                   // samples of the strip chart window
+        uint64_t strip_end;
+        double newest_timestamp;                // x origin of a strip chart in seconds
+        double x_begin;
+        double x_end;
+        double y_axis_min;                      // after the cross-instance sync
+        double y_axis_max;
+        size_t columns;
+    };
+
+    // a ready-to-draw frame, one panel per channel stacked bottom to top
+    struct FrameGeometry
+    {
+        PanelGeometry panels[MAX_CHANNEL_COUNT];
+        size_t panel_count;
+        double panel_height;                    // projection units
+        unsigned long long sequence;            // 0: nothing built yet
+        double build_seconds;                   // time the geometry thread took to build it
+        double newest_timestamp;                // arrival of the newest sample of the mode, 0: none
+    };
+
+    // what the GUI wants drawn
+    struct GeometryRequest
+    {
+        ModeType mode;
+        ViewState view;
+        int plot_width;              // pixels, at most two points are drawn per column
+    };
+
+    // The geometry thread builds a FrameGeometry from the current snapshot
+    // and request into back and swaps it with published; display() swaps
+    // published into front and only draws it. The swaps are O(1), so
+    // neither thread waits for the other to finish a frame.
+    struct GeometryBuffers
+    {
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        GeometryRequest request;
+        bool dirty;                  // new request or snapshot since the last build
+        bool has_published;
+        bool quit;
+        FrameGeometry back;          // geometry thread only
+        FrameGeometry published;
+        FrameGeometry front;         // GL thread only
+        std::atomic<unsigned long long> published_sequence;
+        // geometry thread only: the last build of every panel and its key
+        PanelGeometry built[MODE_COUNT][MAX_CHANNEL_COUNT];
+        PanelKey built_keys[MODE_COUNT][MAX_CHANNEL_COUNT];
+        unsigned long long panel_version;
+    };
+    static GeometryBuffers geometry;
+    static unsigned long long drawn_sequence;
+    // rebuild at least this often to follow the y-axes of the other instances
+    static constexpr const unsigned int GEOMETRY_REFRESH_MS = 100;
+
+#ifndef GRAPH_HEADLESS
+    // what the overload indicator in the window shows
+    struct IngestStatus
+    {
+        double behind;               // seconds, 0 unless at least BEHIND_THRESHOLD
+        unsigned long long dropped;
+        unsigned long long coalesced;
+    };
+    static IngestStatus drawn_status;
+    static uint32_t drawn_alarms;
+    static constexpr const double BEHIND_THRESHOLD = 0.5;
+#endif
+
+    // Arrival intervals between consecutive records of each series, kept by
+    // the serial thread for the report at exit. The buffers are allocated and
+    // touched before acquisition starts and then used as rings.
+    static constexpr const size_t JITTER_CAPACITY = 65536;
+    struct JitterStats
+    {
+        struct Series
+        {
+            double last_timestamp;         // negative until the first record
+            size_t count;                  // intervals seen, the last JITTER_CAPACITY are kept
+            std::vector<double> intervals;
+        };
+        bool enabled;
+        Series series[MODE_COUNT][MAX_CHANNEL_COUNT];
+    };
+    static JitterStats jitter_stats;
+
+    // serial thread stack touched by --realtime before the first read
+    static constexpr const size_t REALTIME_STACK_PREFAULT = 64 * 1024;
+
+    // Rollup tiers of every series, see rollup.h. The serial thread folds
+    // each record into the open bucket of every tier and hands closed
+    // buckets to the log thread, which appends them to the sidecar files
+    // together with its next batch of the output file.
+    struct RollupBucket
     {
-        double count_mode_x_axis_max;
-        double count_array_max;
-        double count_array_min;
-        std::vector<double> count_array;
+        int64_t start;
+        double min;
+        double max;
+        double sum;
+        uint32_t count;              // 0: no bucket open
     };
-    static CountModeData count_mode_data = {
-        .count_mode_x_axis_max = 18.0, 
-        .count_array_max = -std::numeric_limits<double>::max(),
-        .count_array_min = std::numeric_limits<double>::max(),
-        .count_array = std::vector<double>()
+    struct RollupState
+    {
+        int fds[ROLLUP_TIER_COUNT];
+        double realtime_offset;      // CLOCK_REALTIME - CLOCK_MONOTONIC at startup
+        RollupBucket open[ROLLUP_TIER_COUNT][MODE_COUNT][MAX_CHANNEL_COUNT];  // serial thread only
+        std::vector<RollupRecord> pending[ROLLUP_TIER_COUNT];                 // log_writer.mutex
     };
+    static RollupState rollups;
+    // closed buckets the pending lists hold without reallocating
+    static constexpr const size_t ROLLUP_PENDING_RESERVE = 1024;
 
-    struct FitTestModeData
+    // Session checkpoint file (--checkpoint): a CheckpointFileHeader followed
+    // by chunks, each a CheckpointChunk and count elements padded to 8 bytes.
+    // Series only grow between resets, so a checkpoint appends what was added
+    // since the previous one: the new values, timestamps and flags of every
+    // series and the range tree nodes from the last one of each level on,
+    // which later appends may have changed. A RESET chunk clears the store of
+    // a mode. Every checkpoint ends with a COMMIT chunk holding the axis and
+    // view state; it is written and synced after the chunks before it are on
+    // disk, so a crash at any point leaves the previous checkpoint readable
+    // and the torn tail is cut off at startup. The file is rewritten from
+    // scratch once resets have left it mostly dead data.
+    static constexpr const uint32_t CHECKPOINT_MAGIC = 0x50434b43; // "CKCP"
+    static constexpr const uint32_t CHECKPOINT_VERSION = 1;
+    enum CheckpointChunkKind : uint8_t
+    {
+        // zero is no kind, so a block that never reached the disk ends the scan
+        CHECKPOINT_RESET = 1,
+        CHECKPOINT_VALUES,
+        CHECKPOINT_TIMESTAMPS,
+        CHECKPOINT_FLAGS,
+        CHECKPOINT_TREE_MIN,
+        CHECKPOINT_TREE_MAX,
+        CHECKPOINT_COMMIT,
+        // --compact-history: whole QuantizedBlocks, offset and count in blocks
+        CHECKPOINT_COMPACT_VALUES,
+        CHECKPOINT_COMPACT_TREE_MIN,
+        CHECKPOINT_COMPACT_TREE_MAX
+    };
+    struct CheckpointFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t chunk_size;
+        uint32_t commit_size;
+    };
+    struct CheckpointChunk
+    {
+        uint8_t kind;                // CheckpointChunkKind
+        uint8_t mode;                // as in LiveRecord
+        uint8_t channel;
+        uint8_t level;               // range tree level, the one above the series is 0
+        uint32_t reserved;
+        uint64_t offset;             // index of the first element
+        uint64_t count;              // elements that follow
+    };
+    static_assert(sizeof(CheckpointChunk) == 24, "Unexpected CheckpointChunk size");
+    struct CheckpointCommit
+    {
+        uint64_t sequence;
+        double x_axis_max[MODE_COUNT];
+        uint8_t mode;                // displayed mode
+        uint8_t zoomed;              // view of the displayed mode
+        uint8_t reserved[6];
+        double x_begin;
+        double x_end;
+    };
+    static_assert(sizeof(CheckpointCommit) % 8 == 0, "CheckpointCommit must keep chunks aligned");
+    // what the file holds of one series
+    struct CheckpointMark
+    {
+        size_t samples;
+        std::vector<size_t> levels;  // nodes of every range tree level
+    };
+    struct CheckpointState
     {
-        double fit_test_mode_x_axis_max;
-        double sample_array_max;
-        double sample_array_min;
-        double ambient_array_max;
-        double ambient_array_min;
-        double fit_factor_array_max;
-        double fit_factor_array_min;
-        std::vector<double> sample_array, ambient_array, fit_factor_array;
+        int fd;
+        off_t file_size;
+        size_t live_bytes;           // what a rewrite would take
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        bool quit;
+        // checkpoint thread only
+        std::vector<char> batch;
+        CheckpointCommit last_commit;
+        unsigned long long generation[MODE_COUNT];
+        CheckpointMark marks[MODE_COUNT][MAX_CHANNEL_COUNT];
     };
-    static FitTestModeData fit_test_mode_data = {
-        .fit_test_mode_x_axis_max = 18.0,
-        .sample_array_max = -std::numeric_limits<double>::max(),
-        .sample_array_min = std::numeric_limits<double>::max(),
-        .ambient_array_max = -std::numeric_limits<double>::max(),
-        .ambient_array_min = std::numeric_limits<double>::max(),
-        .fit_factor_array_max = -std::numeric_limits<double>::max(),
-        .fit_factor_array_min = std::numeric_limits<double>::max(),
-        .sample_array = std::vector<double>(),
-        .ambient_array = std::vector<double>(),
-        .fit_factor_array = std::vector<double>()
+    static CheckpointState checkpoint;
+    // rewrite once the file is this many times larger than the live data, and at least
+    static constexpr const size_t CHECKPOINT_COMPACT_RATIO = 2;
+    static constexpr const off_t CHECKPOINT_COMPACT_MIN_BYTES = 4 * 1024 * 1024;
+
+#ifndef GRAPH_HEADLESS
+    struct MouseDrag
+    {
+        bool active;
+        int last_x;
     };
+    static MouseDrag mouse_drag = {.active = false, .last_x = 0};
+#endif
 
     struct Color
     {
@@ -165,6 +832,90 @@ namespace
         double B_value;
     };
     static Color color = {.R_value = 1.0, .G_value = 0.0, .B_value = 0.0};
+
+#ifndef GRAPH_HEADLESS
+    // Render quality governor (--frame-budget-ms). The window has no
+    // multisample buffer; display() draws into offscreen framebuffers with
+    // the multisampling and resolution of the current level and blits the
+    // result into the window. The governor times every frame and steps one
+    // level down after a few frames over the budget, and one level up after
+    // raise_after frames well under it. raise_after doubles whenever a raise
+    // is soon followed by a lowering, so the level settles instead of
+    // oscillating. Levels above --max-samples are never used.
+    struct RenderQualityLevel
+    {
+        int samples;                 // 0: no multisampling
+        bool smooth;                 // GL_POINT_SMOOTH and GL_LINE_SMOOTH
+        bool nicest;                 // smoothing hints GL_NICEST, otherwise GL_FASTEST
+        double scale;                // render resolution relative to the window
+    };
+    static constexpr const size_t RENDER_QUALITY_LEVEL_COUNT = 8;
+    static constexpr const RenderQualityLevel render_quality_levels[RENDER_QUALITY_LEVEL_COUNT] = {
+        {.samples = 16, .smooth = true, .nicest = true, .scale = 1.0},
+        {.samples = 8, .smooth = true, .nicest = true, .scale = 1.0},
+        {.samples = 4, .smooth = true, .nicest = false, .scale = 1.0},
+        {.samples = 2, .smooth = true, .nicest = false, .scale = 1.0},
+        {.samples = 0, .smooth = true, .nicest = false, .scale = 1.0},
+        {.samples = 0, .smooth = false, .nicest = false, .scale = 1.0},
+        {.samples = 0, .smooth = false, .nicest = false, .scale = 0.75},
+        {.samples = 0, .smooth = false, .nicest = false, .scale = 0.5}
+    };
+    enum RenderFramebuffer : size_t
+    {
+        RENDER_FRAMEBUFFER_MULTISAMPLED,
+        RENDER_FRAMEBUFFER_SCALED,
+        RENDER_FRAMEBUFFER_COUNT
+    };
+    struct RenderGovernor
+    {
+        bool has_framebuffers;       // OpenGL 3.0, otherwise only the smoothing changes
+        int max_samples;             // --max-samples within GL_MAX_SAMPLES
+        size_t level;
+        double frame_start;
+        double frame_ms;             // moving average, 0: none yet at this level
+        unsigned int over_budget;    // consecutive frames
+        unsigned int under_budget;
+        unsigned int raise_after;
+        unsigned int frames_since_raise;
+        // what the framebuffers were made for, 0 names: not made
+        int width;
+        int height;
+        int samples;
+        GLuint framebuffers[RENDER_FRAMEBUFFER_COUNT];
+        GLuint renderbuffers[RENDER_FRAMEBUFFER_COUNT][2];  // color, depth
+    };
+    static RenderGovernor render_governor;
+    static constexpr const double RENDER_GOVERNOR_SMOOTHING = 0.25;
+    static constexpr const double RENDER_GOVERNOR_RAISE_FRACTION = 0.5;   // of the budget
+    static constexpr const unsigned int RENDER_GOVERNOR_LOWER_FRAMES = 3;
+    static constexpr const unsigned int RENDER_GOVERNOR_RAISE_FRAMES = 20;
+    static constexpr const unsigned int RENDER_GOVERNOR_MAX_RAISE_FRAMES = 640;
+
+    // Unless the governor runs or --full-redraw is given, the panels are
+    // drawn into a multisampled framebuffer object kept between frames and
+    // resolved into the window. display() clears and redraws only the pixel
+    // rows of the panels whose version changed, under a scissor rectangle,
+    // and everything else is what the previous frames drew. A panel draws
+    // into its band, the top one up to the top of the window, and its
+    // topmost labels and points reach PANEL_SPILL into the band above, so
+    // every panel reaching into the rectangle is drawn again within it.
+    struct PanelCache
+    {
+        bool enabled;                // OpenGL 3.0 framebuffer objects
+        int samples;
+        // what the framebuffer was made for, 0 name: not made
+        int width;
+        int height;
+        GLuint framebuffer;
+        GLuint renderbuffers[2];     // color, depth
+        // what it holds
+        size_t panel_count;
+        unsigned long long versions[MAX_CHANNEL_COUNT];
+    };
+    static PanelCache panel_cache;
+    static constexpr const double PANEL_SPILL = 0.2;    // projection units
+    static constexpr const double POINT_SIZE = 8.0;     // pixels
+#endif
     
     struct SharedMemoryBuffer
     {
@@ -172,26 +923,14 @@ namespace
         std::atomic<bool> quit;
         bool valid;
         ModeType mode;
-        struct CountMode
+        struct ChannelAxis
         {
             bool y_axis_valid;
             double y_axis_min;
             double y_axis_max;
         };
-        struct FitTestMode
-        {
-            bool sample_y_axis_valid;
-            bool ambient_y_axis_valid;
-            bool fit_factor_y_axis_valid;
-            double sample_y_axis_min;
-            double sample_y_axis_max;
-            double ambient_y_axis_min;
-            double ambient_y_axis_max;
-            double fit_factor_y_axis_min;
-            double fit_factor_y_axis_max;
-        };
-        CountMode count_mode;
-        FitTestMode fit_test_mode;
+        // indexed by ModeType, then by the channel of that mode
+        ChannelAxis axes[MODE_COUNT][MAX_CHANNEL_COUNT];
     };
     static sem_t **semaphore_ptrs;
     static SharedMemoryBuffer **shared_memory_ptrs;
@@ -203,19 +942,111 @@ namespace
     };
     static InstanceData instance;
 
-    static constexpr const char *const shared_memory_prefix = "/Portacount_vyjcicyipdclbkthgcrppallfevgbjkk";
+    static constexpr const char *const shared_memory_prefix = portacount_shm_prefix;
+
+    // this instance's feed of parsed records for other local processes, see live_feed.h
+    static LiveFeedHeader *live_feed;
+
+    // --attach: the feed of the daemon this viewer shows, instead of live_feed
+    static const LiveFeedHeader *attached_feed;
+
+    // Fleet log: one bounded ring in shared memory that the serial threads of
+    // all instances append their framed lines to, drained by the instance
+    // with --fleet-record into a single recording ordered by arrival time.
+    // CLOCK_MONOTONIC is the same for every process on the host, so the
+    // timestamps of all instances are directly comparable.
+    //
+    // Position p uses slot p % FLEET_LOG_CAPACITY in lap p / FLEET_LOG_CAPACITY.
+    // The slot state is 2 * lap while the slot is free for that lap and
+    // 2 * lap + 1 once the line is in it, so the zero-filled object is an
+    // empty ring. A writer claims position head with a CAS if the slot is free
+    // for it and then copies its line in; when the slot still holds the line
+    // of the previous lap the ring is full and the line is dropped rather
+    // than waited for. The drainer frees a slot for the next lap after
+    // copying it out. There is at most one drainer: it registers its pid in
+    // the header, and one of a process that no longer exists is taken over.
+    static constexpr const uint64_t FLEET_LOG_CAPACITY = 4096;
+    static_assert( (FLEET_LOG_CAPACITY & (FLEET_LOG_CAPACITY - 1) ) == 0, "FLEET_LOG_CAPACITY must be a power of two");
+    static constexpr const size_t FLEET_LINE_SIZE = 300;
+    struct FleetLine
+    {
+        double timestamp;            // CLOCK_MONOTONIC seconds, as in the output file
+        uint32_t source;             // instance index
+        uint32_t length;
+        char text[FLEET_LINE_SIZE];
+    };
+    struct alignas(64) FleetLogSlot
+    {
+        std::atomic<uint64_t> state;
+        FleetLine line;
+    };
+    struct alignas(64) FleetLogHeader
+    {
+        alignas(64) std::atomic<uint64_t> head;     // positions claimed by writers
+        alignas(64) std::atomic<uint64_t> tail;     // positions drained
+        std::atomic<uint64_t> dropped;              // lines that found the ring full
+        std::atomic<int32_t> drainer;               // pid of the --fleet-record instance, 0: none
+    };
+    struct FleetLogState
+    {
+        FleetLogHeader *header;      // NULL: --fleet not given
+        FleetLogSlot *slots;
+        int record_fd;               // the recording, drainer only
+        std::atomic<bool> quit;
+    };
+    static FleetLogState fleet_log;
+    // lines are written in arrival order once they are this old, to give
+    // writers that stamped a line but were not yet done appending it time
+    static constexpr const double FLEET_REORDER_SECONDS = 0.5;
+    static constexpr const unsigned int FLEET_POLL_MS = 20;
 
+    // Parsed records on their way from the serial thread to the ingest
+    // thread, which owns the data model. StringBuffer is one framed line.
+    // The queue holds at most options.ingest_queue_records; what happens to
+    // a record that does not fit is options.ingest_policy.
     struct MutexQueue
     {
         struct StringBuffer
         {
             size_t size;
+            double timestamp;
             char buf[300];
         };
-        std::queue<StringBuffer, std::deque<StringBuffer>> string_queue;
+        struct QueuedRecord
+        {
+            LiveRecord record;
+            unsigned int weight;         // readings averaged into record
+        };
+        std::queue<QueuedRecord, std::deque<QueuedRecord>> record_queue;
         std::mutex queue_mutex;
+        std::condition_variable wakeup;
+        std::condition_variable space;   // BLOCK policy
+        bool quit;
+        std::atomic<unsigned long long> dropped;
+        std::atomic<unsigned long long> coalesced;
+    };
+    static MutexQueue ingest_queue;
+
+    // longest time published ops wait for the GUI to release the other copy
+    static constexpr const int INGEST_RETRY_MS = 20;
+    // how often the GUI checks for a new snapshot
+    static constexpr const unsigned int REDRAW_POLL_MS = 20;
+    // how often a headless daemon publishes its y-axes to the other instances
+    static constexpr const long HEADLESS_SYNC_MS = 1000;
+    // how often an attached viewer looks for new records of the daemon
+    static constexpr const unsigned int ATTACH_POLL_MS = 10;
+
+    // A headless daemon without a strip chart or checkpoints keeps no
+    // history, only what its y-axes need: the running min and max of every
+    // series and the newest arrival of each mode, kept by the ingest thread.
+    struct HeadlessAxes
+    {
+        std::mutex mutex;
+        double min[MODE_COUNT][MAX_CHANNEL_COUNT];   // +inf / -inf: no record yet
+        double max[MODE_COUNT][MAX_CHANNEL_COUNT];
+        double newest[MODE_COUNT];                   // 0: no record yet
     };
-    static MutexQueue mutex_string_queue;
+    static HeadlessAxes headless_axes;
 
     struct ThreadInfo
     {
@@ -223,636 +1054,4191 @@ namespace
     };
     static ThreadInfo thread_info;
 
-    static void reshape(const int width, const int height) 
+    static void *series_block_acquire(void)
     {
-        window.window_width  = width;
-        window.window_height = height; 
+        if(series_block_pool.free_blocks.empty() == true)
+        {
+            void *arena;
+            checkError(posix_memalign(&arena, CACHE_LINE_BYTES, SERIES_BLOCK_BYTES * SERIES_ARENA_BLOCKS), 0, "posix_memalign error");
+            series_block_pool.arena_count++;
+            // handed out in address order
+            for(size_t i = SERIES_ARENA_BLOCKS; i > 0; i--)
+            {
+                series_block_pool.free_blocks.push_back(static_cast<char *>(arena) + SERIES_BLOCK_BYTES * (i - 1) );
+            }
+        }
+        void *const block = series_block_pool.free_blocks.back();
+        series_block_pool.free_blocks.pop_back();
+        return block;
+    }
 
-        // update viewport
-        glViewport(0, 0, width, height);  
+    template <class T>
+    static inline T &segmented_at(SegmentedVector<T> &vector, const size_t index)
+    {
+        return vector.blocks[index / SegmentedVector<T>::BLOCK_ELEMENTS][index % SegmentedVector<T>::BLOCK_ELEMENTS];
     }
 
-    static void keyboard_func(const unsigned char key, const int x, const int y)
+    template <class T>
+    static inline const T &segmented_at(const SegmentedVector<T> &vector, const size_t index)
     {
-        (void)x;
-        (void)y;
+        return vector.blocks[index / SegmentedVector<T>::BLOCK_ELEMENTS][index % SegmentedVector<T>::BLOCK_ELEMENTS];
+    }
 
-        switch(key)
+    template <class T>
+    static inline void segmented_push_back(SegmentedVector<T> &vector, const T value)
+    {
+        const size_t offset = vector.size % SegmentedVector<T>::BLOCK_ELEMENTS;
+        if(offset == 0)
         {
-            case 'q':
-            case 'Q':
-                glutLeaveMainLoop();
-                break;
-
-            case 'c':
-            case 'C':
-                mode = ModeType::COUNT_MODE;
-                // signal redraw
-                glutPostRedisplay();
-                break;
-
-            case 'f':
-            case 'F':
-                mode = ModeType::FIT_TEST_MODE;
-                // signal redraw
-                glutPostRedisplay();
-                break;
-
-            case 'x':
-            case 'X':
-                if(mode == ModeType::COUNT_MODE)
-                {
-                    count_mode_data.count_array.clear();
-                    count_mode_data.count_array.shrink_to_fit();
-                    count_mode_data.count_array.reserve(20);
-                    count_mode_data.count_mode_x_axis_max = 18.0;
-                    count_mode_data.count_array_max = -std::numeric_limits<double>::max();
-                    count_mode_data.count_array_min = std::numeric_limits<double>::max();
-                }
-                else if(mode == ModeType::FIT_TEST_MODE)
-                {
-                    fit_test_mode_data.sample_array.clear();
-                    fit_test_mode_data.sample_array.shrink_to_fit();
-                    fit_test_mode_data.sample_array.reserve(20);
-                    fit_test_mode_data.ambient_array.clear();
-                    fit_test_mode_data.ambient_array.shrink_to_fit();
-                    fit_test_mode_data.ambient_array.reserve(20);
-                    fit_test_mode_data.fit_factor_array.clear();
-                    fit_test_mode_data.fit_factor_array.shrink_to_fit();
-                    fit_test_mode_data.fit_factor_array.reserve(20);
-                    fit_test_mode_data.fit_test_mode_x_axis_max = 18.0;
-                    fit_test_mode_data.sample_array_max = -std::numeric_limits<double>::max();
-                    fit_test_mode_data.sample_array_min = std::numeric_limits<double>::max();
-                    fit_test_mode_data.ambient_array_max = -std::numeric_limits<double>::max();
-                    fit_test_mode_data.ambient_array_min = std::numeric_limits<double>::max();
-                    fit_test_mode_data.fit_factor_array_max = -std::numeric_limits<double>::max();
-                    fit_test_mode_data.fit_factor_array_min = std::numeric_limits<double>::max();
-                }
-                // signal redraw
-                glutPostRedisplay();
-                break;
+            vector.blocks.push_back(static_cast<T *>(series_block_acquire() ) );
         }
+        vector.blocks.back()[offset] = value;
+        vector.size++;
     }
 
-    static void draw_vertical_linear_lines(const double x_begin, const double x_inc,
-        const double y_begin, const double y_end, const unsigned int count)
+    // returns the blocks to the pool, the directory keeps its capacity
+    template <class T>
+    static void segmented_clear(SegmentedVector<T> &vector)
     {
-        double vertex_x = x_begin;
-        const double vertex1_y = y_begin;
-        const double vertex2_y = y_end;
-
-        glBegin(GL_LINES);
-        for(unsigned int i = 0; i < count; i++)
+        for(T *const block : vector.blocks)
         {
-            glVertex3d(vertex_x, vertex1_y, 0.0);
-            glVertex3d(vertex_x, vertex2_y, 0.0);
-            vertex_x += x_inc;
+            series_block_pool.free_blocks.push_back(block);
         }
-        glEnd();
+        vector.blocks.clear();
+        vector.size = 0;
     }
 
-    static void draw_horizontal_log10_lines(const double x_begin, const double x_end,
-        const double y_begin, const double y_inc, const unsigned int count)
+    // calls function(index, element) for [begin, end), one block at a time
+    template <class T, class Function>
+    static inline void segmented_for_each(const SegmentedVector<T> &vector, size_t begin, const size_t end, Function function)
     {
-        const double vertex1_x = x_begin;
-        const double vertex2_x = x_end;
-        double vertex_y = y_begin;
-
-        glBegin(GL_LINES);
-        for(unsigned int i = 0; i < count; i++)
+        while(begin < end)
         {
-            glVertex3d(vertex1_x, vertex_y, 0.0);
-            glVertex3d(vertex2_x, vertex_y, 0.0);
-            for(unsigned int j = 2; j <= 9; j++)
+            const size_t block_begin = begin - begin % SegmentedVector<T>::BLOCK_ELEMENTS;
+            const size_t block_end = std::min(end, block_begin + SegmentedVector<T>::BLOCK_ELEMENTS);
+            const T *const block = vector.blocks[block_begin / SegmentedVector<T>::BLOCK_ELEMENTS];
+            for(size_t i = begin; i < block_end; i++)
             {
-                const double y_minor = static_cast<double>(j);
-                double log_y = log10(y_minor);
-                log_y *= y_inc;
-                glVertex3d(vertex1_x + 0.1, vertex_y + log_y, 0.0);
-                glVertex3d(vertex2_x, vertex_y + log_y, 0.0);
+                function(i, block[i - block_begin]);
             }
-            vertex_y += y_inc;            
+            begin = block_end;
         }
-        glVertex3d(vertex1_x, vertex_y, 0.0);
-        glVertex3d(vertex2_x, vertex_y, 0.0);
-        glEnd();
     }
 
-    static void draw_horizontal_string(const char *const str, const double scale, const double translate_x, const double translate_y)
+    template <class T>
+    static inline void segmented_set(SegmentedVector<T> &vector, const size_t index, const T value)
     {
-        glPushMatrix();
-        glTranslated(translate_x, translate_y, 0.0);
-        glScaled(scale, scale, scale);
-        glutStrokeString(GLUT_STROKE_MONO_ROMAN, reinterpret_cast<const unsigned char *>(str) );
-        glPopMatrix();
+        segmented_at(vector, index) = value;
     }
 
-    static void draw_vertical_string(const char *const str, const double scale, const double translate_x, const double translate_y)
+    static inline double quantized_decode(const QuantizedBlock &block, const uint16_t code)
     {
-        glPushMatrix();
-        glTranslated(translate_x, translate_y, 0.0);
-        glRotated(90.0, 0.0, 0.0, 1.0);
-        glScaled(scale, scale, scale);
-        glutStrokeString(GLUT_STROKE_MONO_ROMAN, reinterpret_cast<const unsigned char *>(str) );
+        return block.base + static_cast<double>(code) * block.scale;
+    }
+
+    // false if value is outside the range of block
+    static inline bool quantized_encode(const QuantizedBlock &block, const double value, const QuantizeRounding rounding, uint16_t &code)
+    {
+        const double position = (value - block.base) / block.scale;
+        const double rounded = (rounding == QUANTIZE_DOWN) ? floor(position) : ( (rounding == QUANTIZE_UP) ? ceil(position) : rint(position) );
+        if( (rounded >= 0.0 && rounded <= QUANTIZED_MAX_CODE) == false)
+        {
+            return false;
+        }
+        code = static_cast<uint16_t>(rounded);
+        return true;
+    }
+
+    // re-encodes the first count codes of block at the finest coarser scale that also fits value
+    static void quantized_widen(QuantizedBlock &block, const size_t count, const double value, const QuantizeRounding rounding)
+    {
+        double low = value;
+        double high = value;
+        for(size_t i = 0; i < count; i++)
+        {
+            low = fmin(low, quantized_decode(block, block.codes[i]) );
+            high = fmax(high, quantized_decode(block, block.codes[i]) );
+        }
+        const QuantizedBlock old = block;
+        do
+        {
+            block.scale *= 2.0;
+            block.base = floor(low / block.scale) * block.scale;
+        }
+        while(high > block.base + QUANTIZED_MAX_CODE * block.scale);
+        for(size_t i = 0; i < count; i++)
+        {
+            const bool encoded = quantized_encode(block, quantized_decode(old, old.codes[i]), rounding, block.codes[i]);
+            assertWithMsg(encoded == true, "Unexpected quantization range");
+        }
+    }
+
+    static inline double quantized_at(const QuantizedVector &vector, const size_t index)
+    {
+        const QuantizedBlock &block = *vector.blocks[index / QuantizedVector::BLOCK_ELEMENTS];
+        return quantized_decode(block, block.codes[index % QuantizedVector::BLOCK_ELEMENTS]);
+    }
+
+    // index is at most vector.size
+    static void quantized_store(QuantizedVector &vector, const size_t index, const double value)
+    {
+        const double clamped = fmax(fmin(value, QUANTIZED_VALUE_LIMIT), -QUANTIZED_VALUE_LIMIT);
+        const size_t block_begin = index - index % QuantizedVector::BLOCK_ELEMENTS;
+        QuantizedBlock &block = *vector.blocks[index / QuantizedVector::BLOCK_ELEMENTS];
+        uint16_t &code = block.codes[index - block_begin];
+        if(quantized_encode(block, clamped, vector.rounding, code) == false)
+        {
+            quantized_widen(block, std::min(vector.size - block_begin, static_cast<size_t>(QuantizedVector::BLOCK_ELEMENTS) ), clamped, vector.rounding);
+            const bool encoded = quantized_encode(block, clamped, vector.rounding, code);
+            assertWithMsg(encoded == true, "Unexpected quantization range");
+        }
+    }
+
+    // the overloads below let the range tree and the geometry take either kind of history
+    static inline double segmented_at(const QuantizedVector &vector, const size_t index)
+    {
+        return quantized_at(vector, index);
+    }
+
+    static inline void segmented_set(QuantizedVector &vector, const size_t index, const double value)
+    {
+        quantized_store(vector, index, value);
+    }
+
+    static inline void segmented_push_back(QuantizedVector &vector, const double value)
+    {
+        if(vector.size % QuantizedVector::BLOCK_ELEMENTS == 0)
+        {
+            // a new block starts at the finest scale, centered on its first value
+            QuantizedBlock *const block = static_cast<QuantizedBlock *>(series_block_acquire() );
+            const double clamped = fmax(fmin(value, QUANTIZED_VALUE_LIMIT), -QUANTIZED_VALUE_LIMIT);
+            block->scale = QUANTIZED_MIN_SCALE;
+            block->base = (floor(clamped / QUANTIZED_MIN_SCALE) - 32768.0) * QUANTIZED_MIN_SCALE;
+            vector.blocks.push_back(block);
+        }
+        quantized_store(vector, vector.size, value);
+        vector.size++;
+    }
+
+    static void segmented_clear(QuantizedVector &vector)
+    {
+        for(QuantizedBlock *const block : vector.blocks)
+        {
+            series_block_pool.free_blocks.push_back(block);
+        }
+        vector.blocks.clear();
+        vector.size = 0;
+    }
+
+    // decodes a block at a time
+    template <class Function>
+    static inline void segmented_for_each(const QuantizedVector &vector, size_t begin, const size_t end, Function function)
+    {
+        while(begin < end)
+        {
+            const size_t block_begin = begin - begin % QuantizedVector::BLOCK_ELEMENTS;
+            const size_t block_end = std::min(end, block_begin + QuantizedVector::BLOCK_ELEMENTS);
+            const QuantizedBlock &block = *vector.blocks[block_begin / QuantizedVector::BLOCK_ELEMENTS];
+            const double base = block.base;
+            const double scale = block.scale;
+            for(size_t i = begin; i < block_end; i++)
+            {
+                function(i, base + static_cast<double>(block.codes[i - block_begin]) * scale);
+            }
+            begin = block_end;
+        }
+    }
+
+    static inline void range_tree_add_level(RangeMinMaxTree<SegmentedVector<double>> &tree)
+    {
+        tree.level_min.push_back(SegmentedVector<double>() );
+        tree.level_max.push_back(SegmentedVector<double>() );
+    }
+
+    static inline void range_tree_add_level(RangeMinMaxTree<QuantizedVector> &tree)
+    {
+        tree.level_min.push_back(QuantizedVector() );
+        tree.level_min.back().rounding = QUANTIZE_DOWN;
+        tree.level_max.push_back(QuantizedVector() );
+        tree.level_max.back().rounding = QUANTIZE_UP;
+    }
+
+    template <class Vector>
+    static inline double range_tree_child_min(const RangeMinMaxTree<Vector> &tree, const Vector &values, const size_t level, const size_t index)
+    {
+        return segmented_at( (level == 0) ? values : tree.level_min[level - 1], index);
+    }
+
+    template <class Vector>
+    static inline double range_tree_child_max(const RangeMinMaxTree<Vector> &tree, const Vector &values, const size_t level, const size_t index)
+    {
+        return segmented_at( (level == 0) ? values : tree.level_max[level - 1], index);
+    }
+
+    // call after appending to values
+    template <class Vector>
+    static void range_tree_append(RangeMinMaxTree<Vector> &tree, const Vector &values)
+    {
+        assertWithMsg(values.size > 0, "Unexpected empty series");
+        size_t index = values.size - 1;
+        for(size_t level = 0; ; level++)
+        {
+            const size_t child_count = (level == 0) ? values.size : tree.level_min[level - 1].size;
+            if(child_count <= 1)
+            {
+                break;
+            }
+            const size_t parent = index >> 1;
+            const size_t left = parent << 1;
+            const size_t right = left + 1;
+            double node_min = range_tree_child_min(tree, values, level, left);
+            double node_max = range_tree_child_max(tree, values, level, left);
+            if(right < child_count)
+            {
+                node_min = fmin(node_min, range_tree_child_min(tree, values, level, right) );
+                node_max = fmax(node_max, range_tree_child_max(tree, values, level, right) );
+            }
+            if(tree.level_min.size() == level)
+            {
+                range_tree_add_level(tree);
+            }
+            Vector &parent_min = tree.level_min[level];
+            Vector &parent_max = tree.level_max[level];
+            if(parent == parent_min.size)
+            {
+                segmented_push_back(parent_min, node_min);
+                segmented_push_back(parent_max, node_max);
+            }
+            else
+            {
+                segmented_set(parent_min, parent, node_min);
+                segmented_set(parent_max, parent, node_max);
+            }
+            index = parent;
+        }
+    }
+
+    // min/max of values[begin, end), (max, -max) if the range is empty
+    template <class Vector>
+    static std::pair<double, double> range_tree_query(const RangeMinMaxTree<Vector> &tree, const Vector &values, const size_t begin, const size_t end)
+    {
+        double range_min = std::numeric_limits<double>::max();
+        double range_max = -std::numeric_limits<double>::max();
+        size_t left = begin;
+        size_t right = (end < values.size) ? end : values.size;
+        for(size_t level = 0; left < right; level++)
+        {
+            if( (left & 1) != 0)
+            {
+                range_min = fmin(range_min, range_tree_child_min(tree, values, level, left) );
+                range_max = fmax(range_max, range_tree_child_max(tree, values, level, left) );
+                left++;
+            }
+            if( (right & 1) != 0)
+            {
+                right--;
+                range_min = fmin(range_min, range_tree_child_min(tree, values, level, right) );
+                range_max = fmax(range_max, range_tree_child_max(tree, values, level, right) );
+            }
+            left >>= 1;
+            right >>= 1;
+        }
+        return std::make_pair(range_min, range_max);
+    }
+
+    template <class Vector>
+    static void range_tree_clear(RangeMinMaxTree<Vector> &tree)
+    {
+        for(size_t level = 0; level < tree.level_min.size(); level++)
+        {
+            segmented_clear(tree.level_min[level]);
+            segmented_clear(tree.level_max[level]);
+        }
+        tree.level_min.clear();
+        tree.level_max.clear();
+    }
+
+    static inline bool strip_chart_enabled(void)
+    {
+        return options.strip_chart_seconds > 0.0 || options.strip_chart_samples > 0;
+    }
+
+    static inline size_t strip_index(const StripSeries &strip, const uint64_t position)
+    {
+        return static_cast<size_t>(position & (strip.values.size() - 1) );
+    }
+
+    // moves the ring contents to their indices in a ring of capacity
+    template <class T>
+    static void strip_ring_resize(std::vector<T> &ring, const uint64_t begin, const uint64_t end, const size_t capacity)
+    {
+        std::vector<T> resized(capacity);
+        for(uint64_t position = begin; position < end; position++)
+        {
+            resized[static_cast<size_t>(position & (capacity - 1) )] = ring[static_cast<size_t>(position & (ring.size() - 1) )];
+        }
+        ring.swap(resized);
+    }
+
+    static void strip_grow(StripSeries &strip, const size_t capacity)
+    {
+        strip_ring_resize(strip.min_queue.positions, strip.min_queue.begin, strip.min_queue.end, capacity);
+        strip_ring_resize(strip.max_queue.positions, strip.max_queue.begin, strip.max_queue.end, capacity);
+        strip_ring_resize(strip.values, strip.begin, strip.end, capacity);
+        strip_ring_resize(strip.timestamps, strip.begin, strip.end, capacity);
+        strip_ring_resize(strip.flags, strip.begin, strip.end, capacity);
+    }
+
+    static inline uint64_t &monotonic_queue_at(MonotonicQueue &queue, const uint64_t position)
+    {
+        return queue.positions[static_cast<size_t>(position & (queue.positions.size() - 1) )];
+    }
+
+    static inline uint64_t monotonic_queue_front(const MonotonicQueue &queue)
+    {
+        return queue.positions[static_cast<size_t>(queue.begin & (queue.positions.size() - 1) )];
+    }
+
+    // drops the positions whose value is not better than value, then adds position
+    template <class Compare>
+    static inline void monotonic_queue_push(MonotonicQueue &queue, const StripSeries &strip, const uint64_t position, const double value, Compare better)
+    {
+        while(queue.end > queue.begin && better(strip.values[strip_index(strip, monotonic_queue_at(queue, queue.end - 1) )], value) == false)
+        {
+            queue.end--;
+        }
+        monotonic_queue_at(queue, queue.end) = position;
+        queue.end++;
+    }
+
+    static void strip_pop_front(StripSeries &strip)
+    {
+        if(strip.min_queue.end > strip.min_queue.begin && monotonic_queue_front(strip.min_queue) == strip.begin)
+        {
+            strip.min_queue.begin++;
+        }
+        if(strip.max_queue.end > strip.max_queue.begin && monotonic_queue_front(strip.max_queue) == strip.begin)
+        {
+            strip.max_queue.begin++;
+        }
+        strip.begin++;
+    }
+
+    static void strip_append(StripSeries &strip, const double value, const double timestamp, const uint8_t flags)
+    {
+        if(options.strip_chart_samples > 0 && strip.end - strip.begin == options.strip_chart_samples)
+        {
+            strip_pop_front(strip);
+        }
+        if(strip.end - strip.begin == strip.values.size() )
+        {
+            strip_grow(strip, std::max(strip.values.size() * 2, STRIP_INITIAL_CAPACITY) );
+        }
+        const size_t index = strip_index(strip, strip.end);
+        strip.values[index] = value;
+        strip.timestamps[index] = timestamp;
+        strip.flags[index] = flags;
+        monotonic_queue_push(strip.min_queue, strip, strip.end, value, [](const double queued, const double added){ return queued < added; });
+        monotonic_queue_push(strip.max_queue, strip, strip.end, value, [](const double queued, const double added){ return queued > added; });
+        strip.end++;
+    }
+
+    // drops the samples that arrived before oldest
+    static void strip_evict(StripSeries &strip, const double oldest)
+    {
+        while(strip.end > strip.begin && strip.timestamps[strip_index(strip, strip.begin)] < oldest)
+        {
+            strip_pop_front(strip);
+        }
+    }
+
+    // keeps the ring capacity for the next window
+    static void strip_clear(StripSeries &strip)
+    {
+        strip.begin = 0;
+        strip.end = 0;
+        strip.min_queue.begin = 0;
+        strip.min_queue.end = 0;
+        strip.max_queue.begin = 0;
+        strip.max_queue.end = 0;
+    }
+
+    // min/max of the window, (max, -max) if it is empty
+    static inline std::pair<double, double> strip_min_max(const StripSeries &strip)
+    {
+        if(strip.end == strip.begin)
+        {
+            return std::make_pair(std::numeric_limits<double>::max(), -std::numeric_limits<double>::max() );
+        }
+        return std::make_pair(strip.values[strip_index(strip, monotonic_queue_front(strip.min_queue) )],
+            strip.values[strip_index(strip, monotonic_queue_front(strip.max_queue) )]);
+    }
+
+    // samples in the history of series, whichever kind it is
+    template <class Series>
+    static inline size_t series_size(const Series &series)
+    {
+        return (options.compact_history == true) ? series.compact_values.size : series.values.size;
+    }
+
+    // min/max of the values [begin, end) of series, (max, -max) if the range is empty
+    template <class Series>
+    static inline std::pair<double, double> series_query(const Series &series, const size_t begin, const size_t end)
+    {
+        if(options.compact_history == true)
+        {
+            return range_tree_query(series.compact_tree, series.compact_values, begin, end);
+        }
+        return range_tree_query(series.tree, series.values, begin, end);
+    }
+
+    // calls function(index, value) for [begin, end)
+    template <class Series, class Function>
+    static inline void series_for_each(const Series &series, const size_t begin, const size_t end, Function function)
+    {
+        if(options.compact_history == true)
+        {
+            segmented_for_each(series.compact_values, begin, end, function);
+            return;
+        }
+        segmented_for_each(series.values, begin, end, function);
+    }
+
+    template <class Channels>
+    static void series_store_reset(SeriesStore<Channels> &store)
+    {
+        for(size_t channel = 0; channel < Channels::CHANNEL_COUNT; channel++)
+        {
+            typename SeriesStore<Channels>::Series &series = store.series[channel];
+            segmented_clear(series.values);
+            segmented_clear(series.timestamps);
+            segmented_clear(series.flags);
+            range_tree_clear(series.tree);
+            segmented_clear(series.compact_values);
+            range_tree_clear(series.compact_tree);
+            strip_clear(series.strip);
+        }
+        store.x_axis_max = 18.0;
+        store.generation++;
+    }
+
+    template <class Channels>
+    static void series_store_append(SeriesStore<Channels> &store, const size_t channel, const double value, const double timestamp, const uint8_t flags)
+    {
+        typename SeriesStore<Channels>::Series &series = store.series[channel];
+        if(strip_chart_enabled() == true)
+        {
+            strip_append(series.strip, value, timestamp, flags);
+            // the window of every series of the store ends at the newest sample
+            for(size_t other = 0; other < Channels::CHANNEL_COUNT && options.strip_chart_seconds > 0.0; other++)
+            {
+                strip_evict(store.series[other].strip, timestamp - options.strip_chart_seconds);
+            }
+            return;
+        }
+        if(options.compact_history == true)
+        {
+            segmented_push_back(series.compact_values, value);
+            range_tree_append(series.compact_tree, series.compact_values);
+        }
+        else
+        {
+            segmented_push_back(series.values, value);
+            range_tree_append(series.tree, series.values);
+        }
+        segmented_push_back(series.timestamps, timestamp);
+        segmented_push_back(series.flags, flags);
+        if(static_cast<double>(series.timestamps.size) > store.x_axis_max)
+        {
+            store.x_axis_max *= 2.0;
+        }
+    }
+
+    // log10 of a reading, as plotted
+    static inline double reading_to_value(const ChannelDescriptor &descriptor, const double reading, uint8_t &flags)
+    {
+        if(descriptor.clamp_zero == true && reading == 0.0)
+        {
+            // change 0.0 to 0.001 to avoid log(0)
+            flags |= SAMPLE_FLAG_ZERO_CLAMPED;
+            return log10(0.001);
+        }
+        return log10(reading);
+    }
+
+    // Matches line against the formats of a channel set. reading is the value
+    // as reported, value is the log10 that gets plotted. Returns false if the
+    // line is not a record of any channel in the set.
+    template <class Channels>
+    static bool parse_channel_record(const char *const line, size_t &channel, double &reading, double &value, uint8_t &flags)
+    {
+        for(channel = 0; channel < Channels::CHANNEL_COUNT; channel++)
+        {
+            const ChannelDescriptor &descriptor = Channels::descriptors[channel];
+            for(const RecordFormat &format : descriptor.formats)
+            {
+                double val;
+                int matched_length = 0;
+                // the formats come from the constant descriptor tables above,
+                // %n is only reached when the whole format matched
+                #pragma GCC diagnostic push
+                #pragma GCC diagnostic ignored "-Wformat-nonliteral"
+                if(format.scan_format == NULL || sscanf(line, format.scan_format, &val, &matched_length) != 1 || matched_length == 0)
+                {
+                    continue;
+                }
+                #pragma GCC diagnostic pop
+                reading = val;
+                flags = format.flags;
+                value = reading_to_value(descriptor, val, flags);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <class Channels>
+    static bool parse_live_record(const char *const line, const double timestamp, LiveRecord &record)
+    {
+        size_t channel;
+        memset(&record, 0, sizeof(record) );
+        if(parse_channel_record<Channels>(line, channel, record.reading, record.value, record.flags) == false)
+        {
+            return false;
+        }
+        record.timestamp = timestamp;
+        record.mode = static_cast<uint8_t>(Channels::MODE);
+        record.channel = static_cast<uint8_t>(channel);
+        return true;
+    }
+
+    static void model_apply(DataModel &model, const ModelOp &op)
+    {
+        if(op.record.mode == static_cast<uint8_t>(ModeType::COUNT_MODE) )
+        {
+            if(op.reset == true)
+            {
+                series_store_reset(model.count_mode);
+                return;
+            }
+            series_store_append(model.count_mode, op.record.channel, op.record.value, op.record.timestamp, op.record.flags);
+        }
+        else
+        {
+            if(op.reset == true)
+            {
+                series_store_reset(model.fit_test_mode);
+                return;
+            }
+            series_store_append(model.fit_test_mode, op.record.channel, op.record.value, op.record.timestamp, op.record.flags);
+        }
+    }
+
+    static void snapshots_init(void)
+    {
+        for(size_t i = 0; i < 2; i++)
+        {
+            series_store_reset(snapshots.models[i].count_mode);
+            series_store_reset(snapshots.models[i].fit_test_mode);
+            snapshots.readers[i].store(0);
+            snapshots.applied[i] = 0;
+        }
+        snapshots.active.store(0);
+        snapshots.version.store(0);
+        snapshots.pending_since.store(0.0);
+        snapshots.log_begin = 0;
+        snapshots.log.clear();
+        for(size_t i = 0; i < MODE_COUNT; i++)
+        {
+            snapshots.reset_requested[i].store(false);
+            views[i].zoomed = false;
+        }
+        drawn_sequence = 0;
+    }
+
+    // ingest thread only
+    static void snapshot_log(const ModelOp &op)
+    {
+        snapshots.log.push_back(op);
+    }
+
+    // Ingest thread only. Brings the inactive copy up to date and makes it
+    // the active one, unless the GUI is still reading it.
+    static void snapshot_publish(void)
+    {
+        const unsigned int inactive = 1 - snapshots.active.load(std::memory_order_relaxed);
+        const unsigned long long log_end = snapshots.log_begin + snapshots.log.size();
+        if(snapshots.applied[inactive] == log_end || snapshots.readers[inactive].load(std::memory_order_seq_cst) != 0)
+        {
+            return;
+        }
+        DataModel &model = snapshots.models[inactive];
+        for(unsigned long long op = snapshots.applied[inactive]; op < log_end; op++)
+        {
+            model_apply(model, snapshots.log[static_cast<size_t>(op - snapshots.log_begin)]);
+        }
+        snapshots.applied[inactive] = log_end;
+        snapshots.active.store(inactive, std::memory_order_seq_cst);
+        snapshots.version.fetch_add(1, std::memory_order_release);
+
+        const unsigned long long both_applied = std::min(snapshots.applied[0], snapshots.applied[1]);
+        while(snapshots.log_begin < both_applied)
+        {
+            snapshots.log.pop_front();
+            snapshots.log_begin++;
+        }
+    }
+
+    // GUI side. Pins the active copy until snapshot_release; the ingest thread
+    // flips away from it meanwhile and leaves it alone.
+    static unsigned int snapshot_acquire(void)
+    {
+        for(;;)
+        {
+            const unsigned int index = snapshots.active.load(std::memory_order_seq_cst);
+            snapshots.readers[index].fetch_add(1, std::memory_order_seq_cst);
+            // the ingest thread may have flipped and started on this copy
+            // before it saw the reader, then it is no longer active
+            if(snapshots.active.load(std::memory_order_seq_cst) == index)
+            {
+                return index;
+            }
+            snapshots.readers[index].fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+
+    static void snapshot_release(const unsigned int index)
+    {
+        snapshots.readers[index].fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+#ifndef GRAPH_HEADLESS
+    static inline std::pair<double, double> view_x_range(const ViewState &view, const double x_axis_max)
+    {
+        if(view.zoomed == false)
+        {
+            return std::make_pair(0.0, x_axis_max);
+        }
+        return std::make_pair(view.x_begin, view.x_end);
+    }
+
+    // indices [first, last) of the samples inside the visible x range
+    static inline std::pair<size_t, size_t> visible_index_range(const double x_begin, const double x_end, const size_t size)
+    {
+        const double first = ceil(fmax(x_begin, 0.0) );
+        const double last = floor(fmax(x_end, -1.0) ) + 1.0;
+        const size_t first_index = (first < static_cast<double>(size) ) ? static_cast<size_t>(first) : size;
+        const size_t last_index = (last < static_cast<double>(size) ) ? static_cast<size_t>(last) : size;
+        return std::make_pair(first_index, (last_index > first_index) ? last_index : first_index);
+    }
+
+    static inline std::pair<ViewState *, double> current_view(void)
+    {
+        const unsigned int index = snapshot_acquire();
+        const DataModel &model = snapshots.models[index];
+        const double x_axis_max = (mode == ModeType::COUNT_MODE) ? model.count_mode.x_axis_max : model.fit_test_mode.x_axis_max;
+        snapshot_release(index);
+        return std::make_pair(&views[static_cast<size_t>(mode)], x_axis_max);
+    }
+
+    // anchor is the fraction of the plot width that stays fixed on screen
+    static void zoom_view(ViewState &view, const double x_axis_max, const double anchor, const double factor)
+    {
+        double x_begin, x_end;
+        std::tie(x_begin, x_end) = view_x_range(view, x_axis_max);
+        const double width = x_end - x_begin;
+        const double new_width = fmin(fmax(width * factor, MIN_VIEW_WIDTH), x_axis_max);
+        if(new_width >= x_axis_max)
+        {
+            view.zoomed = false;
+            return;
+        }
+        const double anchor_x = x_begin + anchor * width;
+        const double new_begin = fmin(fmax(anchor_x - anchor * new_width, 0.0), x_axis_max - new_width);
+        view.zoomed = true;
+        view.x_begin = new_begin;
+        view.x_end = new_begin + new_width;
+    }
+
+    // delta is in fractions of the visible width, positive pans towards newer samples
+    static void pan_view(ViewState &view, const double x_axis_max, const double delta)
+    {
+        if(view.zoomed == false)
+        {
+            return;
+        }
+        const double width = view.x_end - view.x_begin;
+        const double new_begin = fmin(fmax(view.x_begin + delta * width, 0.0), x_axis_max - width);
+        view.x_begin = new_begin;
+        view.x_end = new_begin + width;
+    }
+
+    // fraction of the plot width under window coordinate x
+    static inline double window_x_to_plot_fraction(const int x)
+    {
+        const double projection_x = static_cast<double>(x) / static_cast<double>(window.window_width) * (PROJECTION.RIGHT_BOUND - PROJECTION.LEFT_BOUND);
+        return fmin(fmax( (projection_x - 0.75) / 9.0, 0.0), 1.0);
+    }
+
+    // GUI thread: hand the current mode, view and size to the geometry
+    // thread, the timer redraws once the new frame is built
+    static void geometry_request(void)
+    {
+        {
+            const std::lock_guard<std::mutex> lock_mutex(geometry.mutex);
+            geometry.request.mode = mode;
+            geometry.request.view = views[static_cast<size_t>(mode)];
+            geometry.request.plot_width = window.window_width * 9 / 10;
+            geometry.dirty = true;
+        }
+        geometry.wakeup.notify_one();
+    }
+
+    static void reshape(const int width, const int height) 
+    {
+        window.window_width  = width;
+        window.window_height = height; 
+
+        // update viewport
+        glViewport(0, 0, width, height);  
+        geometry_request();
+    }
+
+    static void keyboard_func(const unsigned char key, const int x, const int y)
+    {
+        (void)x;
+        (void)y;
+
+        switch(key)
+        {
+            case 'q':
+            case 'Q':
+                glutLeaveMainLoop();
+                break;
+
+            case 'c':
+            case 'C':
+                mode = ModeType::COUNT_MODE;
+                geometry_request();
+                break;
+
+            case 'f':
+            case 'F':
+                mode = ModeType::FIT_TEST_MODE;
+                geometry_request();
+                break;
+
+            case 'x':
+            case 'X':
+                // the ingest thread clears the store, the timer redraws once it did
+                views[static_cast<size_t>(mode)].zoomed = false;
+                snapshots.reset_requested[static_cast<size_t>(mode)].store(true);
+                ingest_queue.wakeup.notify_one();
+                geometry_request();
+                break;
+
+            case '+':
+            case '=':
+            {
+                const std::pair<ViewState *, double> view = current_view();
+                zoom_view(*view.first, view.second, 0.5, 1.0 / ZOOM_STEP);
+                geometry_request();
+                break;
+            }
+
+            case '-':
+            case '_':
+            {
+                const std::pair<ViewState *, double> view = current_view();
+                zoom_view(*view.first, view.second, 0.5, ZOOM_STEP);
+                geometry_request();
+                break;
+            }
+
+            case 'r':
+            case 'R':
+                current_view().first->zoomed = false;
+                geometry_request();
+                break;
+        }
+    }
+
+    static void special_func(const int key, const int x, const int y)
+    {
+        (void)x;
+        (void)y;
+
+        const std::pair<ViewState *, double> view = current_view();
+        switch(key)
+        {
+            case GLUT_KEY_LEFT:
+                pan_view(*view.first, view.second, -PAN_STEP);
+                geometry_request();
+                break;
+
+            case GLUT_KEY_RIGHT:
+                pan_view(*view.first, view.second, PAN_STEP);
+                geometry_request();
+                break;
+
+            case GLUT_KEY_HOME:
+                view.first->zoomed = false;
+                geometry_request();
+                break;
+        }
+    }
+
+    static void mouse_func(const int button, const int state, const int x, const int y)
+    {
+        (void)y;
+
+        // freeglut reports the scroll wheel as buttons 3 and 4
+        if( (button == 3 || button == 4) && state == GLUT_DOWN)
+        {
+            const std::pair<ViewState *, double> view = current_view();
+            zoom_view(*view.first, view.second, window_x_to_plot_fraction(x), (button == 3) ? (1.0 / ZOOM_STEP) : ZOOM_STEP);
+            geometry_request();
+        }
+        else if(button == GLUT_LEFT_BUTTON)
+        {
+            mouse_drag.active = (state == GLUT_DOWN);
+            mouse_drag.last_x = x;
+        }
+    }
+
+    static void motion_func(const int x, const int y)
+    {
+        (void)y;
+
+        if(mouse_drag.active == false)
+        {
+            return;
+        }
+        const std::pair<ViewState *, double> view = current_view();
+        const double delta = window_x_to_plot_fraction(mouse_drag.last_x) - window_x_to_plot_fraction(x);
+        mouse_drag.last_x = x;
+        pan_view(*view.first, view.second, delta);
+        geometry_request();
+    }
+
+    static inline void add_vertex(std::vector<float> &vertices, const double x, const double y)
+    {
+        vertices.push_back(static_cast<float>(x) );
+        vertices.push_back(static_cast<float>(y) );
+    }
+
+    static void add_vertical_linear_lines(PanelGeometry &panel, const double x_begin, const double x_inc,
+        const double y_begin, const double y_end, const unsigned int count)
+    {
+        double vertex_x = x_begin;
+        const double vertex1_y = y_begin;
+        const double vertex2_y = y_end;
+
+        for(unsigned int i = 0; i < count; i++)
+        {
+            add_vertex(panel.lines, vertex_x, vertex1_y);
+            add_vertex(panel.lines, vertex_x, vertex2_y);
+            vertex_x += x_inc;
+        }
+    }
+
+    static void add_horizontal_log10_lines(PanelGeometry &panel, const double x_begin, const double x_end,
+        const double y_begin, const double y_inc, const unsigned int count)
+    {
+        const double vertex1_x = x_begin;
+        const double vertex2_x = x_end;
+        double vertex_y = y_begin;
+
+        for(unsigned int i = 0; i < count; i++)
+        {
+            add_vertex(panel.lines, vertex1_x, vertex_y);
+            add_vertex(panel.lines, vertex2_x, vertex_y);
+            for(unsigned int j = 2; j <= 9; j++)
+            {
+                const double y_minor = static_cast<double>(j);
+                double log_y = log10(y_minor);
+                log_y *= y_inc;
+                add_vertex(panel.lines, vertex1_x + 0.1, vertex_y + log_y);
+                add_vertex(panel.lines, vertex2_x, vertex_y + log_y);
+            }
+            vertex_y += y_inc;            
+        }
+        add_vertex(panel.lines, vertex1_x, vertex_y);
+        add_vertex(panel.lines, vertex2_x, vertex_y);
+    }
+
+    static void add_label(PanelGeometry &panel, const char *const str, const double scale, const double translate_x, const double translate_y, const bool vertical)
+    {
+        TextLabel label;
+        checkError3(snprintf(label.text, sizeof(label.text), "%s", str), static_cast<int>(sizeof(label.text) ), "snprintf error");
+        label.scale = static_cast<float>(scale);
+        label.x = static_cast<float>(translate_x);
+        label.y = static_cast<float>(translate_y);
+        label.vertical = vertical;
+        panel.labels.push_back(label);
+    }
+
+    static void draw_horizontal_string(const char *const str, const double scale, const double translate_x, const double translate_y)
+    {
+        glPushMatrix();
+        glTranslated(translate_x, translate_y, 0.0);
+        glScaled(scale, scale, scale);
+        glutStrokeString(GLUT_STROKE_MONO_ROMAN, reinterpret_cast<const unsigned char *>(str) );
+        glPopMatrix();
+    }
+
+    static void draw_vertical_string(const char *const str, const double scale, const double translate_x, const double translate_y)
+    {
+        glPushMatrix();
+        glTranslated(translate_x, translate_y, 0.0);
+        glRotated(90.0, 0.0, 0.0, 1.0);
+        glScaled(scale, scale, scale);
+        glutStrokeString(GLUT_STROKE_MONO_ROMAN, reinterpret_cast<const unsigned char *>(str) );
+        glPopMatrix();
+    }
+#endif
+
+    static inline std::tuple<double, double, bool> compute_y_axis(const double min, const double max, const double default_min, const double default_max)
+    {
+        double y_axis_min = floor(min);
+        double y_axis_max = ceil(max);
+        bool default_used = false;
+        if(y_axis_max < y_axis_min)
+        {
+            y_axis_min = default_min;
+            y_axis_max = default_max;
+            default_used = true;
+        }
+        if(y_axis_max - y_axis_min < 1.0)
+        {
+            y_axis_max = y_axis_min + 1.0;
+        }
+        return std::make_tuple(y_axis_min, y_axis_max, default_used);
+    }
+
+    // synchronize y-axis scales across multiple process instances
+    template <class Channels>
+    static void synchronize_y_axes(double (&y_axis_min)[Channels::CHANNEL_COUNT], double (&y_axis_max)[Channels::CHANNEL_COUNT],
+        const bool (&default_y_axis)[Channels::CHANNEL_COUNT])
+    {
+        const size_t mode_index = static_cast<size_t>(Channels::MODE);
+        SharedMemoryBuffer *const own = shared_memory_ptrs[instance.instance_index];
+
+        // Only this thread writes the block of the instance, so it is
+        // compared without the semaphore and written, channel by channel,
+        // only when an axis moved. An attached viewer only reads, the daemon
+        // publishes the axes of the instance.
+        bool any_valid = false;
+        bool changed = false;
+        bool channel_changed[Channels::CHANNEL_COUNT] = {};
+        for(size_t channel = 0; channel < Channels::CHANNEL_COUNT && options.attach == false; channel++)
+        {
+            const SharedMemoryBuffer::ChannelAxis &axis = own->axes[mode_index][channel];
+            channel_changed[channel] = (default_y_axis[channel] == false &&
+                (axis.y_axis_valid == false || axis.y_axis_min != y_axis_min[channel] || axis.y_axis_max != y_axis_max[channel]) );
+            any_valid = (any_valid == true || default_y_axis[channel] == false);
+            changed = (changed == true || channel_changed[channel] == true);
+        }
+        if(any_valid == true && (own->valid == false || own->mode != Channels::MODE) )
+        {
+            changed = true;
+        }
+        if(changed == true)
+        {
+            PORTACOUNT_PROBE1(sync_wait, instance.instance_index);
+            semWaitFully(semaphore_ptrs[instance.instance_index]);
+            PORTACOUNT_PROBE1(sync_acquire, instance.instance_index);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for(size_t channel = 0; channel < Channels::CHANNEL_COUNT; channel++)
+            {
+                if(channel_changed[channel] == true)
+                {
+                    SharedMemoryBuffer::ChannelAxis &axis = own->axes[mode_index][channel];
+                    axis.y_axis_min = y_axis_min[channel];
+                    axis.y_axis_max = y_axis_max[channel];
+                    axis.y_axis_valid = true;
+                }
+            }
+            if(any_valid == true)
+            {
+                own->mode = Channels::MODE;
+                own->valid = true;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            checkError(sem_post(semaphore_ptrs[instance.instance_index]), 0, "sem_post error");
+            PORTACOUNT_PROBE1(sync_release, instance.instance_index);
+        }
+
+        for(unsigned int i = 0; i < instance.total_instances; i++)
+        {
+            if(i == instance.instance_index)
+            {
+                continue;
+            }
+            PORTACOUNT_PROBE1(sync_wait, i);
+            semWaitFully(semaphore_ptrs[i]);
+            PORTACOUNT_PROBE1(sync_acquire, i);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(shared_memory_ptrs[i]->valid == true && shared_memory_ptrs[i]->mode == Channels::MODE)
+            {
+                for(size_t channel = 0; channel < Channels::CHANNEL_COUNT; channel++)
+                {
+                    const SharedMemoryBuffer::ChannelAxis &axis = shared_memory_ptrs[i]->axes[mode_index][channel];
+                    if(axis.y_axis_valid == true)
+                    {
+                        if(axis.y_axis_min < y_axis_min[channel])
+                        {
+                            y_axis_min[channel] = axis.y_axis_min;
+                        }
+                        if(axis.y_axis_max > y_axis_max[channel])
+                        {
+                            y_axis_max[channel] = axis.y_axis_max;
+                        }
+                    }
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            checkError(sem_post(semaphore_ptrs[i]), 0, "sem_post error");
+            PORTACOUNT_PROBE1(sync_release, i);
+        }
+    }
+
+#ifndef GRAPH_HEADLESS
+    // Points of a strip-chart window, x is seconds or samples before the
+    // newest. Like the history, once there are more samples than fit, each
+    // pixel column gets the min and max of its samples.
+    static void add_strip_points(PanelGeometry &panel, const StripSeries &strip, const double x_begin, const double multiplier, const size_t columns,
+        const double newest_timestamp, const double y_min, const double y_inc, const double panel_axis_y_begin)
+    {
+        constexpr const double axis_x_begin = 0.75;
+        const bool decimate = (strip.end - strip.begin > columns * 2);
+        size_t current_column = 0;
+        double column_x = 0.0, column_min = 0.0, column_max = 0.0;
+        bool column_open = false;
+        for(uint64_t position = strip.begin; position < strip.end; position++)
+        {
+            const size_t index = strip_index(strip, position);
+            const double x = (options.strip_chart_seconds > 0.0) ? (strip.timestamps[index] - newest_timestamp) : (static_cast<double>(position + 1) - static_cast<double>(strip.end) );
+            const double fraction = (x - x_begin) * multiplier;
+            const double value = strip.values[index];
+            if(decimate == false)
+            {
+                add_vertex(panel.points, fraction * 9.0 + axis_x_begin, (value - y_min) * y_inc + panel_axis_y_begin);
+                continue;
+            }
+            const size_t column = std::min(static_cast<size_t>(fmax(fraction, 0.0) * static_cast<double>(columns) ), columns - 1);
+            if(column_open == true && column == current_column)
+            {
+                column_min = fmin(column_min, value);
+                column_max = fmax(column_max, value);
+                continue;
+            }
+            if(column_open == true)
+            {
+                add_vertex(panel.points, column_x, (column_min - y_min) * y_inc + panel_axis_y_begin);
+                add_vertex(panel.points, column_x, (column_max - y_min) * y_inc + panel_axis_y_begin);
+            }
+            current_column = column;
+            column_x = (static_cast<double>(column) + 0.5) / static_cast<double>(columns) * 9.0 + axis_x_begin;
+            column_min = value;
+            column_max = value;
+            column_open = true;
+        }
+        if(column_open == true)
+        {
+            add_vertex(panel.points, column_x, (column_min - y_min) * y_inc + panel_axis_y_begin);
+            add_vertex(panel.points, column_x, (column_max - y_min) * y_inc + panel_axis_y_begin);
+        }
+    }
+
+    static inline bool panel_key_equal(const PanelKey &a, const PanelKey &b)
+    {
+        return a.generation == b.generation && a.first_index == b.first_index && a.last_index == b.last_index &&
+            a.strip_begin == b.strip_begin && a.strip_end == b.strip_end && a.newest_timestamp == b.newest_timestamp &&
+            a.x_begin == b.x_begin && a.x_end == b.x_end && a.y_axis_min == b.y_axis_min && a.y_axis_max == b.y_axis_max &&
+            a.columns == b.columns;
+    }
+
+    // grid, labels and points of the panel of one channel
+    template <class Channels>
+    static void build_panel_geometry(const typename SeriesStore<Channels>::Series &series, const size_t channel, const PanelKey &key, PanelGeometry &panel)
+    {
+        constexpr const double axis_x_begin = 0.75;
+        constexpr const double axis_x_end = 10.0;
+        constexpr const double axis_y_begin = 0.5;
+        constexpr const double x_axis_inc = 0.5;
+        constexpr const unsigned int x_axis_count = 19;
+        constexpr const double x_axis_count_divisor = static_cast<double>(x_axis_count) - 1.0;
+
+        panel.lines.clear();
+        panel.points.clear();
+        panel.labels.clear();
+        const unsigned int y_axis_range = static_cast<unsigned int>(rint(key.y_axis_max - key.y_axis_min));
+        const double y_axis_inc = Channels::GRID_HEIGHT / static_cast<double>(y_axis_range);
+        const double panel_y = Channels::PANEL_HEIGHT * static_cast<double>(channel);
+        const double panel_axis_y_begin = axis_y_begin + panel_y;
+
+        // x-axis
+        add_vertical_linear_lines(panel, axis_x_begin, x_axis_inc, panel_axis_y_begin, panel_axis_y_begin + Channels::LINE_HEIGHT, x_axis_count);
+
+        // y-axis
+        add_horizontal_log10_lines(panel, axis_x_begin, axis_x_end, panel_axis_y_begin, y_axis_inc, y_axis_range);
+
+        // x-axis label
+        add_label(panel, "Time", 0.002, 4.5, 0.05 + panel_y, false);
+
+        // x-axis ticks
+        char buf[32];
+        for(unsigned int i = 0; i < x_axis_count; i+=2)
+        {
+            memset(buf, 0, sizeof(buf) );
+            const double temp = rint(key.x_begin + static_cast<double>(i) / x_axis_count_divisor * (key.x_end - key.x_begin) );
+            static_assert(static_cast<int>(sizeof(buf) - 1) == sizeof(buf) - 1, "Size overflow");
+            checkError3(snprintf(buf, sizeof(buf) - 1, "%d", static_cast<int>(temp ) ), static_cast<int>(sizeof(buf) - 1), "snprintf error");
+            add_label(panel, buf, 0.001, axis_x_begin - 0.05 + x_axis_inc * static_cast<double>(i), 0.31 + panel_y, false);
+        }
+
+        // y-axis label
+        add_label(panel, Channels::descriptors[channel].label, 0.002, 0.25, Channels::descriptors[channel].label_y + panel_y, true);
+
+        // y-axis ticks
+        for(unsigned int i = 0; i <= y_axis_range; i++)
+        {
+            memset(buf, 0, sizeof(buf) );
+            static_assert(static_cast<int>(sizeof(buf) - 1) == sizeof(buf) - 1, "Size overflow");
+            checkError3(snprintf(buf, sizeof(buf) - 1, "1e%+d", static_cast<int>(key.y_axis_min) + static_cast<int>(i) ), static_cast<int>(sizeof(buf) - 1), "snprintf error");
+            add_label(panel, buf, 0.001, 0.3, panel_axis_y_begin + y_axis_inc * static_cast<double>(i), false);
+        }
+
+        // data points; once there are more samples than fit, each pixel
+        // column gets the min and max of its samples from the range tree
+        const double multiplier = 1.0 / (key.x_end - key.x_begin);
+        if(strip_chart_enabled() == true)
+        {
+            add_strip_points(panel, series.strip, key.x_begin, multiplier, key.columns, key.newest_timestamp, key.y_axis_min, y_axis_inc, panel_axis_y_begin);
+            return;
+        }
+        const size_t count = key.last_index - key.first_index;
+        if(count <= key.columns * 2)
+        {
+            series_for_each(series, key.first_index, key.last_index, [&](const size_t i, const double value){
+                const double x_coord = (static_cast<double>(i) - key.x_begin) * multiplier * 9.0 + axis_x_begin;
+                const double y_coord = (value - key.y_axis_min) * y_axis_inc + panel_axis_y_begin;
+                add_vertex(panel.points, x_coord, y_coord);
+            });
+            return;
+        }
+        for(size_t column = 0; column < key.columns; column++)
+        {
+            const size_t begin = key.first_index + count * column / key.columns;
+            const size_t end = key.first_index + count * (column + 1) / key.columns;
+            double column_min, column_max;
+            std::tie(column_min, column_max) = series_query(series, begin, end);
+            const double x_coord = (static_cast<double>(begin + end - 1) * 0.5 - key.x_begin) * multiplier * 9.0 + axis_x_begin;
+            add_vertex(panel.points, x_coord, (column_min - key.y_axis_min) * y_axis_inc + panel_axis_y_begin);
+            add_vertex(panel.points, x_coord, (column_max - key.y_axis_min) * y_axis_inc + panel_axis_y_begin);
+        }
+    }
+
+    // One panel per channel, stacked bottom to top. The y-axes are computed
+    // and synchronized for all channels, but only the panels whose key
+    // changed since their last build are built again; the others are copied
+    // from that build, and not even copied if the frame already has it.
+    template <class Channels>
+    static void build_series_store_geometry(const SeriesStore<Channels> &store, const GeometryRequest &request, FrameGeometry &frame)
+    {
+        constexpr const size_t channel_count = Channels::CHANNEL_COUNT;
+        const size_t mode_index = static_cast<size_t>(Channels::MODE);
+
+        // autoscale y-axes to the visible samples; a strip chart shows its
+        // window in seconds or samples before the newest
+        const bool strip_chart = strip_chart_enabled();
+        double x_begin, x_end;
+        if(strip_chart == true)
+        {
+            x_begin = -( (options.strip_chart_seconds > 0.0) ? options.strip_chart_seconds : static_cast<double>(options.strip_chart_samples) );
+            x_end = 0.0;
+        }
+        else
+        {
+            std::tie(x_begin, x_end) = view_x_range(request.view, store.x_axis_max);
+        }
+        PanelKey keys[channel_count];
+        double y_axis_min[channel_count], y_axis_max[channel_count];
+        bool default_y_axis[channel_count];
+        frame.newest_timestamp = 0.0;
+        for(size_t channel = 0; channel < channel_count; channel++)
+        {
+            const typename SeriesStore<Channels>::Series &series = store.series[channel];
+            PanelKey &key = keys[channel];
+            double visible_min, visible_max;
+            if(strip_chart == true)
+            {
+                if(series.strip.end > series.strip.begin)
+                {
+                    frame.newest_timestamp = std::max(frame.newest_timestamp, series.strip.timestamps[strip_index(series.strip, series.strip.end - 1)]);
+                }
+                key.first_index = 0;
+                key.last_index = 0;
+                key.strip_begin = series.strip.begin;
+                key.strip_end = series.strip.end;
+                std::tie(visible_min, visible_max) = strip_min_max(series.strip);
+            }
+            else
+            {
+                if(series.timestamps.size > 0)
+                {
+                    frame.newest_timestamp = std::max(frame.newest_timestamp, segmented_at(series.timestamps, series.timestamps.size - 1) );
+                }
+                std::tie(key.first_index, key.last_index) = visible_index_range(x_begin, x_end, series_size(series) );
+                key.strip_begin = 0;
+                key.strip_end = 0;
+                std::tie(visible_min, visible_max) = series_query(series, key.first_index, key.last_index);
+            }
+            std::tie(y_axis_min[channel], y_axis_max[channel], default_y_axis[channel]) = compute_y_axis(visible_min, visible_max,
+                Channels::descriptors[channel].default_y_axis_min, Channels::descriptors[channel].default_y_axis_max);
+        }
+
+        synchronize_y_axes<Channels>(y_axis_min, y_axis_max, default_y_axis);
+
+        const size_t columns = static_cast<size_t>(std::max(request.plot_width, 1) );
+        for(size_t channel = 0; channel < channel_count; channel++)
+        {
+            PanelKey &key = keys[channel];
+            key.generation = store.generation;
+            // a strip chart in seconds scrolls every panel with the newest sample of any
+            key.newest_timestamp = (strip_chart == true && options.strip_chart_seconds > 0.0) ? frame.newest_timestamp : 0.0;
+            key.x_begin = x_begin;
+            key.x_end = x_end;
+            key.y_axis_min = y_axis_min[channel];
+            key.y_axis_max = y_axis_max[channel];
+            key.columns = columns;
+
+            PanelGeometry &built = geometry.built[mode_index][channel];
+            if(built.version == 0 || panel_key_equal(key, geometry.built_keys[mode_index][channel]) == false)
+            {
+                build_panel_geometry<Channels>(store.series[channel], channel, key, built);
+                built.version = ++geometry.panel_version;
+                geometry.built_keys[mode_index][channel] = key;
+            }
+            if(frame.panels[channel].version != built.version)
+            {
+                frame.panels[channel] = built;
+            }
+        }
+        frame.panel_count = channel_count;
+        frame.panel_height = Channels::PANEL_HEIGHT;
+    }
+
+    // only the panels that changed since their last build, see build_series_store_geometry()
+    static void build_geometry(const DataModel &model, const GeometryRequest &request, FrameGeometry &frame)
+    {
+        if(request.mode == ModeType::COUNT_MODE)
+        {
+            build_series_store_geometry(model.count_mode, request, frame);
+        }
+        else if(request.mode == ModeType::FIT_TEST_MODE)
+        {
+            build_series_store_geometry(model.fit_test_mode, request, frame);
+        }
+    }
+
+    static bool geometry_ready(void)
+    {
+        return geometry.quit == true || geometry.dirty == true;
+    }
+
+    // Rebuilds on a new request or snapshot, and every GEOMETRY_REFRESH_MS in
+    // case the other instances moved their y-axes; a build that changed no
+    // panel is not published.
+    static void geometry_thread(void)
+    {
+        unsigned long long sequence = 0;
+        std::unique_lock<std::mutex> lock(geometry.mutex);
+
+        for(;;)
+        {
+            geometry.wakeup.wait_for(lock, std::chrono::milliseconds(GEOMETRY_REFRESH_MS), geometry_ready);
+            if(geometry.quit == true)
+            {
+                break;
+            }
+            const GeometryRequest request = geometry.request;
+            geometry.dirty = false;
+            lock.unlock();
+
+            const double build_begin = monotonic_seconds();
+            const unsigned int index = snapshot_acquire();
+            build_geometry(snapshots.models[index], request, geometry.back);
+            snapshot_release(index);
+            geometry.back.build_seconds = monotonic_seconds() - build_begin;
+
+            lock.lock();
+            const FrameGeometry &last = geometry.has_published ? geometry.published : geometry.front;
+            bool changed = (sequence == 0 || geometry.back.panel_count != last.panel_count);
+            for(size_t channel = 0; channel < geometry.back.panel_count && changed == false; channel++)
+            {
+                changed = (geometry.back.panels[channel].version != last.panels[channel].version);
+            }
+            if(changed == false)
+            {
+                continue;
+            }
+            geometry.back.sequence = ++sequence;
+            PORTACOUNT_PROBE3(frame_built, sequence, probe_ns(geometry.back.newest_timestamp), probe_ns(geometry.back.build_seconds) );
+            std::swap(geometry.back, geometry.published);
+            geometry.has_published = true;
+            geometry.published_sequence.store(sequence, std::memory_order_release);
+        }
+    }
+
+    static void geometry_close(std::thread &thread)
+    {
+        {
+            const std::lock_guard<std::mutex> lock_mutex(geometry.mutex);
+            geometry.quit = true;
+        }
+        geometry.wakeup.notify_one();
+        thread.join();
+    }
+
+    // GL thread: vertex arrays straight from the panel, labels as stroke text
+    static void draw_panel_geometry(const PanelGeometry &panel)
+    {
+        glEnableClientState(GL_VERTEX_ARRAY);
+
+        glColor3d(0.0, 0.0, 0.0);
+        glVertexPointer(2, GL_FLOAT, 0, panel.lines.data() );
+        glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(panel.lines.size() / 2) );
+
+        for(const TextLabel &label : panel.labels)
+        {
+            if(label.vertical == true)
+            {
+                draw_vertical_string(label.text, label.scale, label.x, label.y);
+            }
+            else
+            {
+                draw_horizontal_string(label.text, label.scale, label.x, label.y);
+            }
+        }
+
+        // points above the grid
+        glColor3d(color.R_value, color.G_value, color.B_value);
+        glPointSize(static_cast<GLfloat>(POINT_SIZE) );
+        glPushMatrix();
+        glTranslated(0.0, 0.0, 0.1);
+        glVertexPointer(2, GL_FLOAT, 0, panel.points.data() );
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(panel.points.size() / 2) );
         glPopMatrix();
+
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+
+    // the points are above the grid of every panel, so the order does not matter
+    static void draw_frame_geometry(const FrameGeometry &frame)
+    {
+        for(size_t channel = 0; channel < frame.panel_count; channel++)
+        {
+            draw_panel_geometry(frame.panels[channel]);
+        }
+    }
+
+    static IngestStatus current_ingest_status(void)
+    {
+        IngestStatus status;
+        const double pending_since = snapshots.pending_since.load(std::memory_order_relaxed);
+        status.behind = (pending_since > 0.0) ? (monotonic_seconds() - pending_since) : 0.0;
+        if(status.behind < BEHIND_THRESHOLD)
+        {
+            status.behind = 0.0;
+        }
+        status.dropped = ingest_queue.dropped.load(std::memory_order_relaxed);
+        status.coalesced = ingest_queue.coalesced.load(std::memory_order_relaxed);
+        return status;
+    }
+
+    // top right corner, only while behind or once records were lost
+    static void draw_ingest_status(void)
+    {
+        char buf[128];
+
+        drawn_status = current_ingest_status();
+        int length = 0;
+        if(drawn_status.behind > 0.0)
+        {
+            length = snprintf(buf, sizeof(buf), "behind by %.1f s", drawn_status.behind);
+        }
+        if(drawn_status.dropped > 0 || drawn_status.coalesced > 0)
+        {
+            checkError3(length, static_cast<int>(sizeof(buf) ), "snprintf error");
+            length += snprintf(buf + length, sizeof(buf) - static_cast<size_t>(length), "%s%llu dropped, %llu coalesced",
+                (length > 0) ? ", " : "", drawn_status.dropped, drawn_status.coalesced);
+        }
+        if(length == 0)
+        {
+            return;
+        }
+        checkError3(length, static_cast<int>(sizeof(buf) ), "snprintf error");
+        glColor3d(0.8, 0.0, 0.0);
+        draw_horizontal_string(buf, 0.0008, 5.0, 9.9);
+    }
+
+    // alarms of the instance shown, the daemon's when attached
+    static inline uint32_t active_alarms(void)
+    {
+        return ( (attached_feed != NULL) ? attached_feed : live_feed)->alarm_active.load(std::memory_order_acquire);
+    }
+
+    // banner across the top while an alarm is active
+    static void draw_alarms(void)
+    {
+        drawn_alarms = active_alarms();
+        if(drawn_alarms == 0)
+        {
+            return;
+        }
+        char buf[128];
+        int length = snprintf(buf, sizeof(buf), "ALARM:");
+        for(uint32_t rule = 0; rule < LIVE_ALARM_RULE_COUNT; rule++)
+        {
+            if( (drawn_alarms & (1U << rule) ) != 0)
+            {
+                checkError3(length, static_cast<int>(sizeof(buf) ), "snprintf error");
+                length += snprintf(buf + length, sizeof(buf) - static_cast<size_t>(length), " %s", alarm_names[rule]);
+            }
+        }
+        checkError3(length, static_cast<int>(sizeof(buf) ), "snprintf error");
+        glColor3d(1.0, 0.0, 0.0);
+        draw_horizontal_string(buf, 0.0015, 0.8, 9.75);
+    }
+
+    static inline bool render_governor_enabled(void)
+    {
+        return options.frame_budget_ms > 0.0;
+    }
+
+    static inline bool panel_cache_wanted(void)
+    {
+        return render_governor_enabled() == false && options.full_redraw == false;
+    }
+
+    // window framebuffer, multisampled up to --max-samples unless the governor or the panel cache renders offscreen
+    static void init_display_mode(const bool multisampled)
+    {
+        if(multisampled == false)
+        {
+            glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_ALPHA | GLUT_DEPTH);
+            return;
+        }
+        glutSetOption(GLUT_MULTISAMPLE, std::min(SAMPLE_COUNT, options.max_samples) );
+        glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_ALPHA | GLUT_DEPTH | ( (options.max_samples > 0) ? GLUT_MULTISAMPLE : 0) );
+    }
+
+    // OpenGL 3.0 framebuffer objects in the current context
+    static inline bool framebuffer_objects_available(void)
+    {
+        const char *const version = reinterpret_cast<const char *>(glGetString(GL_VERSION) );
+        return version != NULL && atoi(version) >= 3;
+    }
+
+    // Creates the window at the position and size set before. Only a context
+    // tells whether the panel cache gets its framebuffer object, so its
+    // window is first created multisampled, as without the cache, and created
+    // again without multisampling once the context turns out to have them.
+    static void create_window(const char *const title)
+    {
+        init_display_mode(render_governor_enabled() == false);
+        const int window_id = glutCreateWindow(title);
+        if(panel_cache_wanted() == true && framebuffer_objects_available() == true)
+        {
+            glutDestroyWindow(window_id);
+            init_display_mode(false);
+            glutCreateWindow(title);
+        }
+    }
+
+    // without framebuffer objects only the smoothing can change
+    static inline bool render_quality_usable(const size_t level)
+    {
+        const RenderQualityLevel &quality = render_quality_levels[level];
+        if(render_governor.has_framebuffers == false)
+        {
+            return quality.samples == 0 && quality.scale >= 1.0;
+        }
+        return quality.samples <= render_governor.max_samples;
+    }
+
+    // after the window exists: framebuffer objects need OpenGL 3.0
+    static void init_render_governor(void)
+    {
+        const char *const version = reinterpret_cast<const char *>(glGetString(GL_VERSION) );
+        render_governor.has_framebuffers = (version != NULL && atoi(version) >= 3);
+        GLint max_samples = 0;
+        if(render_governor.has_framebuffers == true)
+        {
+            glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+        }
+        else
+        {
+            printf("no framebuffer objects in OpenGL %s, the render quality governor only changes smoothing\n", (version != NULL) ? version : "?");
+        }
+        render_governor.max_samples = std::min(options.max_samples, static_cast<int>(max_samples) );
+        render_governor.level = 0;
+        while(render_quality_usable(render_governor.level) == false)
+        {
+            render_governor.level++;
+        }
+        render_governor.frame_ms = 0.0;
+        render_governor.over_budget = 0;
+        render_governor.under_budget = 0;
+        render_governor.raise_after = RENDER_GOVERNOR_RAISE_FRAMES;
+        render_governor.frames_since_raise = RENDER_GOVERNOR_RAISE_FRAMES;
+        render_governor.width = 0;
+        render_governor.height = 0;
+        render_governor.samples = -1;
+        memset(render_governor.framebuffers, 0, sizeof(render_governor.framebuffers) );
+        memset(render_governor.renderbuffers, 0, sizeof(render_governor.renderbuffers) );
+    }
+
+    // a framebuffer with color and depth renderbuffers, left bound
+    static void framebuffer_attach(GLuint &framebuffer, GLuint (&renderbuffers)[2], const int samples, const int width, const int height)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        checkError(glCheckFramebufferStatus(GL_FRAMEBUFFER), static_cast<GLenum>(GL_FRAMEBUFFER_COMPLETE), "glCheckFramebufferStatus error");
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    // (Re)creates the offscreen framebuffers of the current level and window
+    // size: MULTISAMPLED at the render size if the level multisamples,
+    // SCALED single-sampled at the render size if it renders below the
+    // window size, to resolve into or to render to directly.
+    static void render_governor_framebuffers(const RenderQualityLevel &quality, const int width, const int height)
+    {
+        if(width == render_governor.width && height == render_governor.height && quality.samples == render_governor.samples)
+        {
+            return;
+        }
+        for(size_t index = 0; index < RENDER_FRAMEBUFFER_COUNT; index++)
+        {
+            if(render_governor.framebuffers[index] != 0)
+            {
+                glDeleteFramebuffers(1, &render_governor.framebuffers[index]);
+                glDeleteRenderbuffers(2, render_governor.renderbuffers[index]);
+                render_governor.framebuffers[index] = 0;
+            }
+        }
+        if(quality.samples > 0)
+        {
+            framebuffer_attach(render_governor.framebuffers[RENDER_FRAMEBUFFER_MULTISAMPLED], render_governor.renderbuffers[RENDER_FRAMEBUFFER_MULTISAMPLED],
+                quality.samples, width, height);
+        }
+        if(width != window.window_width || height != window.window_height)
+        {
+            framebuffer_attach(render_governor.framebuffers[RENDER_FRAMEBUFFER_SCALED], render_governor.renderbuffers[RENDER_FRAMEBUFFER_SCALED], 0, width, height);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        render_governor.width = width;
+        render_governor.height = height;
+        render_governor.samples = quality.samples;
+    }
+
+    // display(), before drawing: apply the level and pick the framebuffer to draw into
+    static void render_governor_begin(void)
+    {
+        render_governor.frame_start = monotonic_seconds();
+        const RenderQualityLevel &quality = render_quality_levels[render_governor.level];
+        if(quality.smooth == true)
+        {
+            glEnable(GL_POINT_SMOOTH);
+            glEnable(GL_LINE_SMOOTH);
+        }
+        else
+        {
+            glDisable(GL_POINT_SMOOTH);
+            glDisable(GL_LINE_SMOOTH);
+        }
+        glHint(GL_POINT_SMOOTH_HINT, (quality.nicest == true) ? GL_NICEST : GL_FASTEST);
+        glHint(GL_LINE_SMOOTH_HINT, (quality.nicest == true) ? GL_NICEST : GL_FASTEST);
+        if(render_governor.has_framebuffers == false)
+        {
+            return;
+        }
+
+        const int width = std::max(static_cast<int>(lround(window.window_width * quality.scale) ), 1);
+        const int height = std::max(static_cast<int>(lround(window.window_height * quality.scale) ), 1);
+        render_governor_framebuffers(quality, width, height);
+        if(quality.samples > 0)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, render_governor.framebuffers[RENDER_FRAMEBUFFER_MULTISAMPLED]);
+            glEnable(GL_MULTISAMPLE);
+        }
+        else
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, render_governor.framebuffers[RENDER_FRAMEBUFFER_SCALED]);
+            glDisable(GL_MULTISAMPLE);
+        }
+        glViewport(0, 0, width, height);
+    }
+
+    static void render_governor_step(const size_t level, const char *const reason)
+    {
+        const RenderQualityLevel &quality = render_quality_levels[level];
+        printf("render quality %s to %d samples, smoothing %s, scale %.2f (frame %.1f ms, budget %.1f ms)\n", reason, quality.samples,
+            (quality.smooth == false) ? "off" : ( (quality.nicest == true) ? "nicest" : "fastest"), quality.scale, render_governor.frame_ms, options.frame_budget_ms);
+        // the new level is measured afresh
+        render_governor.level = level;
+        render_governor.frame_ms = 0.0;
+        render_governor.over_budget = 0;
+        render_governor.under_budget = 0;
+    }
+
+    // Display(), before the swap: resolve and scale the offscreen frame into
+    // the window, then time the frame and step the level. Waiting for the
+    // renderer here keeps a vsynced swap out of the measurement.
+    static void render_governor_end(void)
+    {
+        const RenderQualityLevel &quality = render_quality_levels[render_governor.level];
+        if(render_governor.has_framebuffers == true)
+        {
+            const int width = render_governor.width;
+            const int height = render_governor.height;
+            const bool scaled = (render_governor.framebuffers[RENDER_FRAMEBUFFER_SCALED] != 0);
+            if(quality.samples > 0)
+            {
+                // a multisampled source is resolved at its own size
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, render_governor.framebuffers[RENDER_FRAMEBUFFER_MULTISAMPLED]);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (scaled == true) ? render_governor.framebuffers[RENDER_FRAMEBUFFER_SCALED] : 0);
+                glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            }
+            if(scaled == true)
+            {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, render_governor.framebuffers[RENDER_FRAMEBUFFER_SCALED]);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+                glBlitFramebuffer(0, 0, width, height, 0, 0, window.window_width, window.window_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, window.window_width, window.window_height);
+        }
+        glFinish();
+
+        const double frame_ms = (monotonic_seconds() - render_governor.frame_start) * 1000.0;
+        render_governor.frame_ms = (render_governor.frame_ms > 0.0) ?
+            (render_governor.frame_ms + (frame_ms - render_governor.frame_ms) * RENDER_GOVERNOR_SMOOTHING) : frame_ms;
+        if(render_governor.frames_since_raise < RENDER_GOVERNOR_RAISE_FRAMES)
+        {
+            render_governor.frames_since_raise++;
+        }
+        render_governor.over_budget = (render_governor.frame_ms > options.frame_budget_ms) ? (render_governor.over_budget + 1) : 0;
+        render_governor.under_budget = (render_governor.frame_ms < options.frame_budget_ms * RENDER_GOVERNOR_RAISE_FRACTION) ? (render_governor.under_budget + 1) : 0;
+
+        size_t level = render_governor.level + 1;
+        while(level < RENDER_QUALITY_LEVEL_COUNT && render_quality_usable(level) == false)
+        {
+            level++;
+        }
+        if(render_governor.over_budget >= RENDER_GOVERNOR_LOWER_FRAMES && level < RENDER_QUALITY_LEVEL_COUNT)
+        {
+            // a raise that did not fit the budget waits twice as long next time
+            if(render_governor.frames_since_raise < RENDER_GOVERNOR_RAISE_FRAMES)
+            {
+                render_governor.raise_after = std::min(render_governor.raise_after * 2, RENDER_GOVERNOR_MAX_RAISE_FRAMES);
+            }
+            render_governor.frames_since_raise = RENDER_GOVERNOR_RAISE_FRAMES;
+            render_governor_step(level, "lowered");
+            return;
+        }
+
+        level = render_governor.level;
+        while(level > 0 && render_quality_usable(level - 1) == false)
+        {
+            level--;
+        }
+        if(render_governor.under_budget >= render_governor.raise_after && level > 0)
+        {
+            render_governor.frames_since_raise = 0;
+            render_governor_step(level - 1, "raised");
+        }
+    }
+
+    // after the window exists: framebuffer objects need OpenGL 3.0
+    static void init_panel_cache(void)
+    {
+        panel_cache.enabled = framebuffer_objects_available();
+        if(panel_cache.enabled == false)
+        {
+            const char *const version = reinterpret_cast<const char *>(glGetString(GL_VERSION) );
+            printf("no framebuffer objects in OpenGL %s, every frame is drawn in full\n", (version != NULL) ? version : "?");
+            return;
+        }
+        GLint max_samples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+        panel_cache.samples = std::min(std::min(SAMPLE_COUNT, options.max_samples), static_cast<int>(max_samples) );
+        panel_cache.width = 0;
+        panel_cache.height = 0;
+        panel_cache.framebuffer = 0;
+        memset(panel_cache.renderbuffers, 0, sizeof(panel_cache.renderbuffers) );
+        panel_cache.panel_count = 0;
+    }
+
+    static void panel_cache_delete(void)
+    {
+        if(panel_cache.framebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &panel_cache.framebuffer);
+            glDeleteRenderbuffers(2, panel_cache.renderbuffers);
+            panel_cache.framebuffer = 0;
+        }
+        panel_cache.width = 0;
+        panel_cache.height = 0;
+    }
+
+    // (Re)creates the framebuffer at the window size; true if it holds nothing yet
+    static bool panel_cache_framebuffer(const int width, const int height)
+    {
+        if(width == panel_cache.width && height == panel_cache.height)
+        {
+            return false;
+        }
+        panel_cache_delete();
+        framebuffer_attach(panel_cache.framebuffer, panel_cache.renderbuffers, panel_cache.samples, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        panel_cache.width = width;
+        panel_cache.height = height;
+        return true;
+    }
+
+    // pixel rows [first, second) that the panel of channel can draw into
+    static std::pair<int, int> panel_cache_rows(const FrameGeometry &frame, const size_t channel, const int height)
+    {
+        const double pixels_per_unit = static_cast<double>(height) / (PROJECTION.TOP_BOUND - PROJECTION.BOTTOM_BOUND);
+        const double bottom = frame.panel_height * static_cast<double>(channel);
+        const double top = (channel + 1 == frame.panel_count) ? PROJECTION.TOP_BOUND : (frame.panel_height * static_cast<double>(channel + 1) + PANEL_SPILL);
+        // points are centered on their vertex
+        const double pad = ceil(POINT_SIZE * 0.5);
+        return std::make_pair(std::max(static_cast<int>(floor(bottom * pixels_per_unit - pad) ), 0),
+            std::min(static_cast<int>(ceil(top * pixels_per_unit + pad) ), height) );
+    }
+
+    // Brings the framebuffer up to the frame, redrawing each run of adjacent
+    // changed panels under one scissor rectangle, and resolves it into the
+    // window. Everything is redrawn after a resize or when the number of
+    // panels changed; a mode switch changes every version.
+    static void panel_cache_draw(const FrameGeometry &frame)
+    {
+        const int width = std::max(window.window_width, 1);
+        const int height = std::max(window.window_height, 1);
+        const bool full = (panel_cache_framebuffer(width, height) == true || frame.panel_count != panel_cache.panel_count);
+        glBindFramebuffer(GL_FRAMEBUFFER, panel_cache.framebuffer);
+        if(full == true)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draw_frame_geometry(frame);
+        }
+        else
+        {
+            glEnable(GL_SCISSOR_TEST);
+            size_t channel = 0;
+            while(channel < frame.panel_count)
+            {
+                if(frame.panels[channel].version == panel_cache.versions[channel])
+                {
+                    channel++;
+                    continue;
+                }
+                size_t last = channel;
+                while(last + 1 < frame.panel_count && frame.panels[last + 1].version != panel_cache.versions[last + 1])
+                {
+                    last++;
+                }
+                const int begin = panel_cache_rows(frame, channel, height).first;
+                const int end = panel_cache_rows(frame, last, height).second;
+                glScissor(0, begin, width, end - begin);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                for(size_t other = 0; other < frame.panel_count; other++)
+                {
+                    const std::pair<int, int> rows = panel_cache_rows(frame, other, height);
+                    if(rows.first < end && rows.second > begin)
+                    {
+                        draw_panel_geometry(frame.panels[other]);
+                    }
+                }
+                channel = last + 1;
+            }
+            glDisable(GL_SCISSOR_TEST);
+        }
+        panel_cache.panel_count = frame.panel_count;
+        for(size_t channel = 0; channel < frame.panel_count; channel++)
+        {
+            panel_cache.versions[channel] = frame.panels[channel].version;
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, panel_cache.framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        const GLenum errCode = glGetError();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if(errCode != GL_NO_ERROR)
+        {
+            // e.g. a window framebuffer the driver made multisampled anyway
+            printf("resolving the panel cache failed (%s), every frame is drawn in full from now on\n", gluErrorString(errCode) );
+            panel_cache_delete();
+            panel_cache.enabled = false;
+            glutPostRedisplay();
+        }
+        // the overlays are drawn straight into the window
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    static void display(void) 
+    {
+        // check if there have been any openGL problems
+        const GLenum errCode = glGetError();
+        if(errCode != GL_NO_ERROR) 
+        {
+            const GLubyte* errString = gluErrorString(errCode);
+            fprintf(stderr, "OpenGL error: %s\n", errString);
+        }
+
+        if(render_governor_enabled() == true)
+        {
+            render_governor_begin();
+        }
+
+        // set the orthographic projection matrix
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        gluOrtho2D(PROJECTION.LEFT_BOUND, PROJECTION.RIGHT_BOUND, PROJECTION.BOTTOM_BOUND, PROJECTION.TOP_BOUND);
+
+        // set up the camera transformation
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+
+        glColor3d(0.0, 0.0, 0.0);
+
+        {
+            const std::lock_guard<std::mutex> lock_mutex(geometry.mutex);
+            if(geometry.has_published == true)
+            {
+                std::swap(geometry.front, geometry.published);
+                geometry.has_published = false;
+            }
+        }
+        drawn_sequence = geometry.front.sequence;
+        if(panel_cache.enabled == true)
+        {
+            panel_cache_draw(geometry.front);
+        }
+        else
+        {
+            // clear the frame buffer
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draw_frame_geometry(geometry.front);
+        }
+
+        draw_ingest_status();
+        draw_alarms();
+
+        if(render_governor_enabled() == true)
+        {
+            render_governor_end();
+        }
+
+        // swap buffers
+        glutSwapBuffers(); 
+        PORTACOUNT_PROBE2(frame_swap, drawn_sequence, probe_ns(geometry.front.newest_timestamp) );
+    }
+#endif
+
+    static bool log_writer_ready(void)
+    {
+        return log_writer.quit == true || log_writer.pending.size() >= options.sync_bytes;
+    }
+
+    static void log_writer_append(const char *const prefix, const size_t prefix_length, const char *const record, const size_t record_length)
+    {
+        bool notify;
+        {
+            const std::lock_guard<std::mutex> lock_mutex(log_writer.mutex);
+            log_writer.pending.insert(log_writer.pending.end(), prefix, prefix + prefix_length);
+            log_writer.pending.insert(log_writer.pending.end(), record, record + record_length);
+            notify = log_writer_ready();
+        }
+        if(notify == true)
+        {
+            log_writer.wakeup.notify_one();
+        }
+    }
+
+    // reserve blocks ahead of the writes so fdatasync rarely has to commit block allocations
+    static void log_writer_preallocate(const off_t end)
+    {
+        if(log_writer.preallocate == false || end <= log_writer.allocated_size)
+        {
+            return;
+        }
+        const off_t step = static_cast<off_t>(options.preallocate_bytes);
+        const off_t length = (end - log_writer.allocated_size + step - 1) / step * step;
+        const int ret = fallocate(fds.outfile_fd, FALLOC_FL_KEEP_SIZE, log_writer.allocated_size, length);
+        if(ret != 0 && (errno == EOPNOTSUPP || errno == ENOSYS) )
+        {
+            log_writer.preallocate = false;
+            return;
+        }
+        checkError(ret, 0, "fallocate error");
+        log_writer.allocated_size += length;
+    }
+
+    static void log_thread(void)
+    {
+        std::vector<char> batch;
+        std::vector<RollupRecord> rollup_batch[ROLLUP_TIER_COUNT];
+        if(options.realtime == true)
+        {
+            // pending and batch trade buffers, so both are pre-faulted
+            batch.resize(log_writer.pending.capacity() );
+            batch.clear();
+        }
+        for(size_t tier = 0; tier < ROLLUP_TIER_COUNT && options.rollups == true; tier++)
+        {
+            rollup_batch[tier].reserve(ROLLUP_PENDING_RESERVE);
+        }
+        std::unique_lock<std::mutex> lock(log_writer.mutex);
+
+        for(;;)
+        {
+            const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.sync_interval_ms);
+            log_writer.wakeup.wait_until(lock, deadline, log_writer_ready);
+            batch.swap(log_writer.pending);
+            for(size_t tier = 0; tier < ROLLUP_TIER_COUNT; tier++)
+            {
+                rollup_batch[tier].swap(rollups.pending[tier]);
+            }
+            const bool quit = log_writer.quit;
+            lock.unlock();
+
+            if(batch.empty() == false)
+            {
+                log_writer_preallocate(log_writer.file_size + static_cast<off_t>(batch.size() ) );
+                writeFully(fds.outfile_fd, batch.data(), batch.size() );
+                log_writer.file_size += static_cast<off_t>(batch.size() );
+                checkError(fdatasync(fds.outfile_fd), 0, "fdatasync error");
+                batch.clear();
+            }
+            for(size_t tier = 0; tier < ROLLUP_TIER_COUNT; tier++)
+            {
+                if(rollup_batch[tier].empty() == false)
+                {
+                    writeFully(rollups.fds[tier], rollup_batch[tier].data(), rollup_batch[tier].size() * sizeof(RollupRecord) );
+                    checkError(fdatasync(rollups.fds[tier]), 0, "fdatasync error");
+                    rollup_batch[tier].clear();
+                }
+            }
+
+            lock.lock();
+            if(quit == true)
+            {
+                break;
+            }
+        }
+    }
+
+    static void log_writer_close(std::thread &thread)
+    {
+        {
+            const std::lock_guard<std::mutex> lock_mutex(log_writer.mutex);
+            log_writer.quit = true;
+        }
+        log_writer.wakeup.notify_one();
+        thread.join();
+
+        // release the preallocated blocks past the end of the log
+        if(log_writer.allocated_size > log_writer.file_size)
+        {
+            checkError(ftruncate(fds.outfile_fd, log_writer.file_size), 0, "ftruncate error");
+            checkError(fdatasync(fds.outfile_fd), 0, "fdatasync error");
+        }
+    }
+
+    // Cuts an output file left by a crash back to its last complete record:
+    // trailing NUL bytes (blocks whose data never reached the disk) and then
+    // everything after the last newline are removed. Returns the bytes dropped.
+    static off_t recover_log_file(const int fd)
+    {
+        struct stat statbuf;
+        char block[4096];
+        off_t keep = 0;
+        bool seen_data = false;
+
+        checkError(fstat(fd, &statbuf), 0, "fstat error");
+        off_t end = statbuf.st_size;
+        while(end > 0 && keep == 0)
+        {
+            const off_t begin = (end > static_cast<off_t>(sizeof(block) ) ) ? (end - static_cast<off_t>(sizeof(block) ) ) : 0;
+            const size_t length = static_cast<size_t>(end - begin);
+            size_t done = 0;
+            while(done < length)
+            {
+                const ssize_t ret = pread(fd, block + done, length - done, begin + static_cast<off_t>(done) );
+                checkError2(ret, -1L, "pread error");
+                assertWithMsg(ret > 0, "Unexpected end of output file");
+                done += static_cast<size_t>(ret);
+            }
+            for(size_t i = length; i > 0; i--)
+            {
+                const char c = block[i - 1];
+                if(seen_data == false && c == '\0')
+                {
+                    continue;
+                }
+                seen_data = true;
+                if(c == '\n')
+                {
+                    keep = begin + static_cast<off_t>(i);
+                    break;
+                }
+            }
+            end = begin;
+        }
+
+        const off_t removed = statbuf.st_size - keep;
+        if(removed > 0)
+        {
+            checkError(ftruncate(fd, keep), 0, "ftruncate error");
+            checkError(fdatasync(fd), 0, "fdatasync error");
+        }
+        return removed;
+    }
+
+    static void rollup_file_name(char *const name, const size_t size, const char *const output_path, const size_t tier)
+    {
+        checkError3(snprintf(name, size - 1, "%s.rollup-%s", output_path, rollup_tier_names[tier]), static_cast<int>(size - 1), "snprintf error");
+    }
+
+    static inline void preadFully(const int fd, void *const buf, const size_t count, const off_t offset)
+    {
+        size_t done = 0;
+        while(done < count)
+        {
+            const ssize_t ret = pread(fd, static_cast<char *>(buf) + done, count - done, offset + static_cast<off_t>(done) );
+            checkError2(ret, -1L, "pread error");
+            assertWithMsg(ret > 0, "Unexpected end of file");
+            done += static_cast<size_t>(ret);
+        }
+    }
+
+    // Checks the header of a sidecar kept with --append and cuts it back to
+    // its last complete bucket, like recover_log_file does for the output file.
+    static void recover_rollup_file(const int fd, const size_t tier)
+    {
+        struct stat statbuf;
+        RollupFileHeader header;
+        RollupRecord record;
+
+        checkError(fstat(fd, &statbuf), 0, "fstat error");
+        if(statbuf.st_size == 0)
+        {
+            return;
+        }
+        assertWithMsg(statbuf.st_size >= static_cast<off_t>(sizeof(header) ), "Rollup file too short");
+        preadFully(fd, &header, sizeof(header), 0);
+        assertWithMsg(header.magic == ROLLUP_MAGIC && header.version == ROLLUP_VERSION && header.record_size == sizeof(RollupRecord) &&
+            header.bucket_seconds == rollup_tier_seconds[tier], "Not a rollup file of this version and tier");
+
+        const off_t records = (statbuf.st_size - static_cast<off_t>(sizeof(header) ) ) / static_cast<off_t>(sizeof(RollupRecord) );
+        off_t keep = static_cast<off_t>(sizeof(header) ) + records * static_cast<off_t>(sizeof(RollupRecord) );
+        // blocks whose data never reached the disk read back as zeros, and no bucket is empty
+        while(keep > static_cast<off_t>(sizeof(header) ) )
+        {
+            preadFully(fd, &record, sizeof(record), keep - static_cast<off_t>(sizeof(record) ) );
+            if(record.count != 0)
+            {
+                break;
+            }
+            keep -= static_cast<off_t>(sizeof(record) );
+        }
+        if(keep < statbuf.st_size)
+        {
+            checkError(ftruncate(fd, keep), 0, "ftruncate error");
+            checkError(fdatasync(fd), 0, "fdatasync error");
+        }
+    }
+
+    // opens the sidecar of every tier next to the output file, before the log thread starts
+    static void init_rollups(const char *const output_path)
+    {
+        struct timespec realtime, monotonic;
+        char name[4096];
+
+        checkError(clock_gettime(CLOCK_REALTIME, &realtime), 0, "clock_gettime error");
+        checkError(clock_gettime(CLOCK_MONOTONIC, &monotonic), 0, "clock_gettime error");
+        rollups.realtime_offset = static_cast<double>(realtime.tv_sec - monotonic.tv_sec) + static_cast<double>(realtime.tv_nsec - monotonic.tv_nsec) * 0.000000001;
+
+        for(size_t tier = 0; tier < ROLLUP_TIER_COUNT; tier++)
+        {
+            rollup_file_name(name, sizeof(name), output_path, tier);
+            if(options.append_output == true)
+            {
+                rollups.fds[tier] = open(name, O_RDWR | O_CLOEXEC | O_CREAT, S_IRUSR | S_IWUSR);
+                checkError2(rollups.fds[tier], -1, "open error");
+                recover_rollup_file(rollups.fds[tier], tier);
+            }
+            else
+            {
+                rollups.fds[tier] = open(name, O_WRONLY | O_CLOEXEC | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+                checkError2(rollups.fds[tier], -1, "open error");
+            }
+            const off_t end = lseek(rollups.fds[tier], 0, SEEK_END);
+            checkError2(end, static_cast<off_t>(-1), "lseek error");
+            if(end == 0)
+            {
+                const RollupFileHeader header = {.magic = ROLLUP_MAGIC, .version = ROLLUP_VERSION, .record_size = sizeof(RollupRecord), .bucket_seconds = rollup_tier_seconds[tier]};
+                writeFully(rollups.fds[tier], &header, sizeof(header) );
+            }
+            rollups.pending[tier].reserve(ROLLUP_PENDING_RESERVE);
+            for(size_t mode_index = 0; mode_index < MODE_COUNT; mode_index++)
+            {
+                for(size_t channel = 0; channel < MAX_CHANNEL_COUNT; channel++)
+                {
+                    rollups.open[tier][mode_index][channel].count = 0;
+                }
+            }
+        }
+    }
+
+    static inline RollupRecord rollup_record(const RollupBucket &bucket, const size_t mode_index, const size_t channel)
+    {
+        RollupRecord record;
+        memset(&record, 0, sizeof(record) );
+        record.start = bucket.start;
+        record.min = static_cast<float>(bucket.min);
+        record.max = static_cast<float>(bucket.max);
+        record.mean = static_cast<float>(bucket.sum / static_cast<double>(bucket.count) );
+        record.count = bucket.count;
+        record.mode = static_cast<uint8_t>(mode_index);
+        record.channel = static_cast<uint8_t>(channel);
+        return record;
+    }
+
+    // serial thread: folds a record into every tier
+    static void rollup_add(const LiveRecord &record)
+    {
+        const double realtime = record.timestamp + rollups.realtime_offset;
+        RollupRecord closed[ROLLUP_TIER_COUNT];
+        size_t closed_tier[ROLLUP_TIER_COUNT];
+        size_t closed_count = 0;
+
+        for(size_t tier = 0; tier < ROLLUP_TIER_COUNT; tier++)
+        {
+            const int64_t seconds = rollup_tier_seconds[tier];
+            const int64_t start = static_cast<int64_t>(floor(realtime / static_cast<double>(seconds) ) ) * seconds;
+            RollupBucket &bucket = rollups.open[tier][record.mode][record.channel];
+            if(bucket.count > 0 && bucket.start != start)
+            {
+                closed[closed_count] = rollup_record(bucket, record.mode, record.channel);
+                closed_tier[closed_count] = tier;
+                closed_count++;
+                bucket.count = 0;
+            }
+            if(bucket.count == 0)
+            {
+                bucket.start = start;
+                bucket.min = record.reading;
+                bucket.max = record.reading;
+                bucket.sum = 0.0;
+            }
+            bucket.min = fmin(bucket.min, record.reading);
+            bucket.max = fmax(bucket.max, record.reading);
+            bucket.sum += record.reading;
+            bucket.count++;
+        }
+
+        if(closed_count > 0)
+        {
+            const std::lock_guard<std::mutex> lock_mutex(log_writer.mutex);
+            for(size_t i = 0; i < closed_count; i++)
+            {
+                rollups.pending[closed_tier[i]].push_back(closed[i]);
+            }
+        }
+    }
+
+    // after the serial thread is gone: the open buckets go out with the last batch
+    static void rollup_flush(void)
+    {
+        const std::lock_guard<std::mutex> lock_mutex(log_writer.mutex);
+        for(size_t tier = 0; tier < ROLLUP_TIER_COUNT; tier++)
+        {
+            for(size_t mode_index = 0; mode_index < MODE_COUNT; mode_index++)
+            {
+                for(size_t channel = 0; channel < MAX_CHANNEL_COUNT; channel++)
+                {
+                    RollupBucket &bucket = rollups.open[tier][mode_index][channel];
+                    if(bucket.count > 0)
+                    {
+                        rollups.pending[tier].push_back(rollup_record(bucket, mode_index, channel) );
+                        bucket.count = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    static void rollup_close(void)
+    {
+        for(size_t tier = 0; tier < ROLLUP_TIER_COUNT; tier++)
+        {
+            checkError(close(rollups.fds[tier]), 0, "close error");
+            rollups.fds[tier] = -1;
+        }
+    }
+
+    static inline size_t checkpoint_element_size(const uint8_t kind)
+    {
+        switch(kind)
+        {
+            case CHECKPOINT_VALUES:
+            case CHECKPOINT_TIMESTAMPS:
+            case CHECKPOINT_TREE_MIN:
+            case CHECKPOINT_TREE_MAX:
+                return sizeof(double);
+            case CHECKPOINT_FLAGS:
+                return sizeof(uint8_t);
+            case CHECKPOINT_COMMIT:
+                return sizeof(CheckpointCommit);
+            case CHECKPOINT_COMPACT_VALUES:
+            case CHECKPOINT_COMPACT_TREE_MIN:
+            case CHECKPOINT_COMPACT_TREE_MAX:
+                return sizeof(QuantizedBlock);
+            default:
+                return 0;
+        }
+    }
+
+    static inline size_t checkpoint_padded(const size_t size)
+    {
+        return (size + 7) & ~static_cast<size_t>(7);
+    }
+
+    static void checkpoint_put_chunk(std::vector<char> &batch, const uint8_t kind, const size_t mode_index, const size_t channel, const size_t level,
+        const size_t offset, const size_t count)
+    {
+        CheckpointChunk chunk;
+        memset(&chunk, 0, sizeof(chunk) );
+        chunk.kind = kind;
+        chunk.mode = static_cast<uint8_t>(mode_index);
+        chunk.channel = static_cast<uint8_t>(channel);
+        chunk.level = static_cast<uint8_t>(level);
+        chunk.offset = offset;
+        chunk.count = count;
+        const char *const bytes = reinterpret_cast<const char *>(&chunk);
+        batch.insert(batch.end(), bytes, bytes + sizeof(chunk) );
+    }
+
+    // elements [begin, size) of vector as one chunk, copied a block at a time
+    template <class T>
+    static void checkpoint_put_array(std::vector<char> &batch, const uint8_t kind, const size_t mode_index, const size_t channel, const size_t level,
+        const SegmentedVector<T> &vector, size_t begin)
+    {
+        checkpoint_put_chunk(batch, kind, mode_index, channel, level, begin, vector.size - begin);
+        const size_t payload_begin = batch.size();
+        while(begin < vector.size)
+        {
+            const size_t block_offset = begin % SegmentedVector<T>::BLOCK_ELEMENTS;
+            const size_t count = std::min(SegmentedVector<T>::BLOCK_ELEMENTS - block_offset, vector.size - begin);
+            const char *const bytes = reinterpret_cast<const char *>(vector.blocks[begin / SegmentedVector<T>::BLOCK_ELEMENTS] + block_offset);
+            batch.insert(batch.end(), bytes, bytes + count * sizeof(T) );
+            begin += count;
+        }
+        batch.resize(payload_begin + checkpoint_padded(batch.size() - payload_begin), '\0');
+    }
+
+    // stores count elements at offset, which is at most vector.size
+    template <class T>
+    static void checkpoint_get_array(SegmentedVector<T> &vector, size_t offset, const char *data, size_t count)
+    {
+        assertWithMsg(offset <= vector.size, "Checkpoint file inconsistent");
+        while(count > 0)
+        {
+            const size_t block_offset = offset % SegmentedVector<T>::BLOCK_ELEMENTS;
+            if(offset / SegmentedVector<T>::BLOCK_ELEMENTS == vector.blocks.size() )
+            {
+                vector.blocks.push_back(static_cast<T *>(series_block_acquire() ) );
+            }
+            const size_t n = std::min(SegmentedVector<T>::BLOCK_ELEMENTS - block_offset, count);
+            memcpy(vector.blocks[offset / SegmentedVector<T>::BLOCK_ELEMENTS] + block_offset, data, n * sizeof(T) );
+            data += n * sizeof(T);
+            offset += n;
+            count -= n;
+            vector.size = std::max(vector.size, offset);
+        }
+    }
+
+    // the whole blocks holding the elements [begin, size) of a compact history
+    static void checkpoint_put_array(std::vector<char> &batch, const uint8_t kind, const size_t mode_index, const size_t channel, const size_t level,
+        const QuantizedVector &vector, const size_t begin)
+    {
+        const size_t first_block = begin / QuantizedVector::BLOCK_ELEMENTS;
+        checkpoint_put_chunk(batch, kind, mode_index, channel, level, first_block, vector.blocks.size() - first_block);
+        for(size_t block = first_block; block < vector.blocks.size(); block++)
+        {
+            const char *const bytes = reinterpret_cast<const char *>(vector.blocks[block]);
+            batch.insert(batch.end(), bytes, bytes + sizeof(QuantizedBlock) );
+        }
+    }
+
+    // stores count blocks at block offset; the size follows from the timestamps
+    static void checkpoint_get_array(QuantizedVector &vector, const size_t offset, const char *data, const size_t count)
+    {
+        assertWithMsg(offset <= vector.blocks.size(), "Checkpoint file inconsistent");
+        for(size_t block = offset; block < offset + count; block++)
+        {
+            if(block == vector.blocks.size() )
+            {
+                vector.blocks.push_back(static_cast<QuantizedBlock *>(series_block_acquire() ) );
+            }
+            memcpy(vector.blocks[block], data, sizeof(QuantizedBlock) );
+            data += sizeof(QuantizedBlock);
+        }
+    }
+
+    static inline size_t checkpoint_vector_bytes(const SegmentedVector<double> &vector)
+    {
+        return vector.size * sizeof(double);
+    }
+
+    static inline size_t checkpoint_vector_bytes(const QuantizedVector &vector)
+    {
+        return vector.blocks.size() * sizeof(QuantizedBlock);
+    }
+
+    // adds the values and range tree nodes of a history that changed since
+    // mark, first_kind is CHECKPOINT_VALUES or CHECKPOINT_COMPACT_VALUES
+    template <class Vector>
+    static void checkpoint_put_history(std::vector<char> &batch, const uint8_t first_kind, const size_t mode_index, const size_t channel,
+        const Vector &values, const RangeMinMaxTree<Vector> &tree, CheckpointMark &mark)
+    {
+        const uint8_t tree_min_kind = static_cast<uint8_t>( (first_kind == CHECKPOINT_VALUES) ? CHECKPOINT_TREE_MIN : CHECKPOINT_COMPACT_TREE_MIN);
+        const uint8_t tree_max_kind = static_cast<uint8_t>( (first_kind == CHECKPOINT_VALUES) ? CHECKPOINT_TREE_MAX : CHECKPOINT_COMPACT_TREE_MAX);
+        checkpoint_put_array(batch, first_kind, mode_index, channel, 0, values, mark.samples);
+        mark.levels.resize(tree.level_min.size(), 0);
+        for(size_t level = 0; level < tree.level_min.size(); level++)
+        {
+            // appends update the last node of every level
+            const size_t begin = (mark.levels[level] > 0) ? (mark.levels[level] - 1) : 0;
+            checkpoint_put_array(batch, tree_min_kind, mode_index, channel, level, tree.level_min[level], begin);
+            checkpoint_put_array(batch, tree_max_kind, mode_index, channel, level, tree.level_max[level], begin);
+            mark.levels[level] = tree.level_min[level].size;
+        }
+    }
+
+    template <class Vector>
+    static size_t checkpoint_history_bytes(const Vector &values, const RangeMinMaxTree<Vector> &tree)
+    {
+        size_t bytes = checkpoint_vector_bytes(values);
+        for(size_t level = 0; level < tree.level_min.size(); level++)
+        {
+            bytes += checkpoint_vector_bytes(tree.level_min[level]) + checkpoint_vector_bytes(tree.level_max[level]);
+        }
+        return bytes;
+    }
+
+    // Checkpoint thread: adds what store gained since the last checkpoint to
+    // the batch. Returns the bytes a rewrite of the store would take.
+    template <class Channels>
+    static size_t checkpoint_capture(const SeriesStore<Channels> &store, std::vector<char> &batch)
+    {
+        const size_t mode_index = static_cast<size_t>(Channels::MODE);
+        size_t live_bytes = 0;
+        if(store.generation != checkpoint.generation[mode_index])
+        {
+            checkpoint_put_chunk(batch, CHECKPOINT_RESET, mode_index, 0, 0, 0, 0);
+            checkpoint.generation[mode_index] = store.generation;
+            for(size_t channel = 0; channel < Channels::CHANNEL_COUNT; channel++)
+            {
+                checkpoint.marks[mode_index][channel].samples = 0;
+                checkpoint.marks[mode_index][channel].levels.clear();
+            }
+        }
+        for(size_t channel = 0; channel < Channels::CHANNEL_COUNT; channel++)
+        {
+            const typename SeriesStore<Channels>::Series &series = store.series[channel];
+            CheckpointMark &mark = checkpoint.marks[mode_index][channel];
+            live_bytes += series.timestamps.size * (sizeof(double) + sizeof(uint8_t) ) + ( (options.compact_history == true) ?
+                checkpoint_history_bytes(series.compact_values, series.compact_tree) : checkpoint_history_bytes(series.values, series.tree) );
+            if(series.timestamps.size == mark.samples)
+            {
+                continue;
+            }
+            checkpoint_put_array(batch, CHECKPOINT_TIMESTAMPS, mode_index, channel, 0, series.timestamps, mark.samples);
+            checkpoint_put_array(batch, CHECKPOINT_FLAGS, mode_index, channel, 0, series.flags, mark.samples);
+            if(options.compact_history == true)
+            {
+                checkpoint_put_history(batch, CHECKPOINT_COMPACT_VALUES, mode_index, channel, series.compact_values, series.compact_tree, mark);
+            }
+            else
+            {
+                checkpoint_put_history(batch, CHECKPOINT_VALUES, mode_index, channel, series.values, series.tree, mark);
+            }
+            mark.samples = series.timestamps.size;
+        }
+        return live_bytes;
+    }
+
+    // Writes a checkpoint of the active snapshot. The snapshot is only pinned
+    // while the new data is copied out; the I/O happens after it is released.
+    static void checkpoint_write(void)
+    {
+        const bool rewrite = checkpoint.file_size > std::max(static_cast<off_t>(CHECKPOINT_COMPACT_RATIO * checkpoint.live_bytes), CHECKPOINT_COMPACT_MIN_BYTES);
+        if(rewrite == true)
+        {
+            for(size_t mode_index = 0; mode_index < MODE_COUNT; mode_index++)
+            {
+                for(size_t channel = 0; channel < MAX_CHANNEL_COUNT; channel++)
+                {
+                    checkpoint.marks[mode_index][channel].samples = 0;
+                    checkpoint.marks[mode_index][channel].levels.clear();
+                }
+            }
+        }
+
+        CheckpointCommit commit;
+        memset(&commit, 0, sizeof(commit) );
+        std::vector<char> &batch = checkpoint.batch;
+        batch.clear();
+        const unsigned int index = snapshot_acquire();
+        const DataModel &model = snapshots.models[index];
+        checkpoint.live_bytes = checkpoint_capture(model.count_mode, batch) + checkpoint_capture(model.fit_test_mode, batch);
+        commit.x_axis_max[static_cast<size_t>(ModeType::COUNT_MODE)] = model.count_mode.x_axis_max;
+        commit.x_axis_max[static_cast<size_t>(ModeType::FIT_TEST_MODE)] = model.fit_test_mode.x_axis_max;
+        snapshot_release(index);
+        {
+            const std::lock_guard<std::mutex> lock_mutex(geometry.mutex);
+            commit.mode = static_cast<uint8_t>(geometry.request.mode);
+            commit.zoomed = (geometry.request.view.zoomed == true) ? 1 : 0;
+            commit.x_begin = geometry.request.view.x_begin;
+            commit.x_end = geometry.request.view.x_end;
+        }
+        commit.sequence = checkpoint.last_commit.sequence;
+        if(rewrite == false && batch.empty() == true && memcmp(&commit, &checkpoint.last_commit, sizeof(commit) ) == 0)
+        {
+            return;
+        }
+        commit.sequence++;
+
+        int fd = checkpoint.fd;
+        char tmp_path[4096];
+        if(rewrite == true)
+        {
+            checkError3(snprintf(tmp_path, sizeof(tmp_path) - 1, "%s.tmp", options.checkpoint_path), static_cast<int>(sizeof(tmp_path) - 1), "snprintf error");
+            fd = open(tmp_path, O_WRONLY | O_CLOEXEC | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+            checkError2(fd, -1, "open error");
+            const CheckpointFileHeader header = {.magic = CHECKPOINT_MAGIC, .version = CHECKPOINT_VERSION, .chunk_size = sizeof(CheckpointChunk), .commit_size = sizeof(CheckpointCommit)};
+            batch.insert(batch.begin(), reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header) + sizeof(header) );
+        }
+        writeFully(fd, batch.data(), batch.size() );
+        checkError(fdatasync(fd), 0, "fdatasync error");
+        const off_t chunks_size = static_cast<off_t>(batch.size() );
+        batch.clear();
+        checkpoint_put_chunk(batch, CHECKPOINT_COMMIT, 0, 0, 0, 0, 1);
+        batch.insert(batch.end(), reinterpret_cast<const char *>(&commit), reinterpret_cast<const char *>(&commit) + sizeof(commit) );
+        writeFully(fd, batch.data(), batch.size() );
+        checkError(fdatasync(fd), 0, "fdatasync error");
+        checkpoint.last_commit = commit;
+
+        if(rewrite == true)
+        {
+            checkError(rename(tmp_path, options.checkpoint_path), 0, "rename error");
+            checkError(close(checkpoint.fd), 0, "close error");
+            checkpoint.fd = fd;
+            checkpoint.file_size = 0;
+        }
+        checkpoint.file_size += chunks_size + static_cast<off_t>(batch.size() );
+    }
+
+    // the chunk at data, or false if it is not a complete and valid chunk
+    static bool checkpoint_chunk_valid(const char *const data, const size_t available, CheckpointChunk &chunk)
+    {
+        if(available < sizeof(chunk) )
+        {
+            return false;
+        }
+        memcpy(&chunk, data, sizeof(chunk) );
+        const size_t element_size = checkpoint_element_size(chunk.kind);
+        const size_t channel_count = (chunk.mode == static_cast<uint8_t>(ModeType::COUNT_MODE) ) ?
+            static_cast<size_t>(CountModeChannels::CHANNEL_COUNT) : static_cast<size_t>(FitTestModeChannels::CHANNEL_COUNT);
+        if( (element_size == 0 && chunk.kind != CHECKPOINT_RESET) || chunk.mode >= MODE_COUNT || chunk.channel >= channel_count ||
+            chunk.level >= 64 || chunk.count > (available - sizeof(chunk) ) / std::max(element_size, static_cast<size_t>(1) ) )
+        {
+            return false;
+        }
+        return (chunk.kind != CHECKPOINT_COMMIT || chunk.count == 1) &&
+            checkpoint_padded(static_cast<size_t>(chunk.count) * element_size) <= available - sizeof(chunk);
+    }
+
+    // stores a values or range tree chunk into values and tree
+    template <class Vector>
+    static void checkpoint_get_history(Vector &values, RangeMinMaxTree<Vector> &tree, const CheckpointChunk &chunk, const char *const data)
+    {
+        const size_t offset = static_cast<size_t>(chunk.offset);
+        const size_t count = static_cast<size_t>(chunk.count);
+        if( (chunk.kind == CHECKPOINT_VALUES) || (chunk.kind == CHECKPOINT_COMPACT_VALUES) )
+        {
+            checkpoint_get_array(values, offset, data, count);
+            return;
+        }
+        assertWithMsg(chunk.level <= tree.level_min.size(), "Checkpoint file inconsistent");
+        if(chunk.level == tree.level_min.size() )
+        {
+            range_tree_add_level(tree);
+        }
+        const bool is_min = (chunk.kind == CHECKPOINT_TREE_MIN) || (chunk.kind == CHECKPOINT_COMPACT_TREE_MIN);
+        checkpoint_get_array(is_min ? tree.level_min[chunk.level] : tree.level_max[chunk.level], offset, data, count);
+    }
+
+    template <class Channels>
+    static void checkpoint_apply(SeriesStore<Channels> &store, const CheckpointChunk &chunk, const char *const data)
+    {
+        if(chunk.kind == CHECKPOINT_RESET)
+        {
+            series_store_reset(store);
+            return;
+        }
+        typename SeriesStore<Channels>::Series &series = store.series[chunk.channel];
+        const size_t offset = static_cast<size_t>(chunk.offset);
+        const size_t count = static_cast<size_t>(chunk.count);
+        if(chunk.kind == CHECKPOINT_TIMESTAMPS)
+        {
+            checkpoint_get_array(series.timestamps, offset, data, count);
+        }
+        else if(chunk.kind == CHECKPOINT_FLAGS)
+        {
+            checkpoint_get_array(series.flags, offset, data, count);
+        }
+        else if(chunk.kind < CHECKPOINT_COMMIT)
+        {
+            assertWithMsg(options.compact_history == false, "Checkpoint file written without --compact-history");
+            checkpoint_get_history(series.values, series.tree, chunk, data);
+        }
+        else
+        {
+            assertWithMsg(options.compact_history == true, "Checkpoint file written with --compact-history");
+            checkpoint_get_history(series.compact_values, series.compact_tree, chunk, data);
+        }
+    }
+
+    // Sets the sizes of a restored compact history, which its chunks of
+    // whole blocks leave open, from the number of samples.
+    template <class Channels>
+    static void checkpoint_size_compact(SeriesStore<Channels> &store)
+    {
+        for(typename SeriesStore<Channels>::Series &series : store.series)
+        {
+            QuantizedVector *vector = &series.compact_values;
+            size_t size = series.timestamps.size;
+            for(size_t level = 0; ; level++)
+            {
+                assertWithMsg(vector->blocks.size() == (size + QuantizedVector::BLOCK_ELEMENTS - 1) / QuantizedVector::BLOCK_ELEMENTS,
+                    "Checkpoint file inconsistent");
+                vector->size = size;
+                if(level > 0)
+                {
+                    QuantizedVector &level_max = series.compact_tree.level_max[level - 1];
+                    assertWithMsg(level_max.blocks.size() == vector->blocks.size(), "Checkpoint file inconsistent");
+                    level_max.size = size;
+                }
+                if(size <= 1 || level == series.compact_tree.level_min.size() )
+                {
+                    break;
+                }
+                vector = &series.compact_tree.level_min[level];
+                size = (size + 1) / 2;
+            }
+        }
+    }
+
+    template <class Vector>
+    static void checkpoint_check_history(const Vector &values, const RangeMinMaxTree<Vector> &tree, const size_t samples)
+    {
+        assertWithMsg(values.size == samples, "Checkpoint file inconsistent");
+        size_t nodes = samples;
+        size_t level = 0;
+        for(; nodes > 1; level++)
+        {
+            nodes = (nodes + 1) / 2;
+            assertWithMsg(level < tree.level_min.size() && tree.level_min[level].size == nodes && tree.level_max[level].size == nodes,
+                "Checkpoint file inconsistent");
+        }
+        assertWithMsg(level == tree.level_min.size(), "Checkpoint file inconsistent");
+    }
+
+    // the restored store must be what appending its samples would have built
+    template <class Channels>
+    static void checkpoint_check(const SeriesStore<Channels> &store)
+    {
+        for(const typename SeriesStore<Channels>::Series &series : store.series)
+        {
+            assertWithMsg(series.flags.size == series.timestamps.size, "Checkpoint file inconsistent");
+            if(options.compact_history == true)
+            {
+                checkpoint_check_history(series.compact_values, series.compact_tree, series.timestamps.size);
+            }
+            else
+            {
+                checkpoint_check_history(series.values, series.tree, series.timestamps.size);
+            }
+        }
+    }
+
+    // notes store as written, returns the bytes a rewrite of it would take
+    template <class Channels>
+    static size_t checkpoint_mark(const SeriesStore<Channels> &store)
+    {
+        const size_t mode_index = static_cast<size_t>(Channels::MODE);
+        size_t live_bytes = 0;
+        checkpoint.generation[mode_index] = store.generation;
+        for(size_t channel = 0; channel < Channels::CHANNEL_COUNT; channel++)
+        {
+            const typename SeriesStore<Channels>::Series &series = store.series[channel];
+            CheckpointMark &mark = checkpoint.marks[mode_index][channel];
+            mark.samples = series.timestamps.size;
+            mark.levels.clear();
+            if(options.compact_history == true)
+            {
+                live_bytes += checkpoint_history_bytes(series.compact_values, series.compact_tree);
+                for(const QuantizedVector &level : series.compact_tree.level_min)
+                {
+                    mark.levels.push_back(level.size);
+                }
+            }
+            else
+            {
+                live_bytes += checkpoint_history_bytes(series.values, series.tree);
+                for(const SegmentedVector<double> &level : series.tree.level_min)
+                {
+                    mark.levels.push_back(level.size);
+                }
+            }
+            live_bytes += series.timestamps.size * (sizeof(double) + sizeof(uint8_t) );
+        }
+        return live_bytes;
+    }
+
+    // Opens the checkpoint file, after snapshots_init and before the ingest
+    // thread starts. An existing file is mapped and its committed chunks are
+    // copied into both snapshot copies; a torn last checkpoint is cut off.
+    static void init_checkpoint(void)
+    {
+        struct stat statbuf;
+        CheckpointFileHeader header;
+        const double start = monotonic_seconds();
+
+        checkpoint.fd = open(options.checkpoint_path, O_RDWR | O_CLOEXEC | O_CREAT, S_IRUSR | S_IWUSR);
+        checkError2(checkpoint.fd, -1, "open error");
+        checkError(fstat(checkpoint.fd, &statbuf), 0, "fstat error");
+        memset(&checkpoint.last_commit, 0, sizeof(checkpoint.last_commit) );
+        checkpoint.quit = false;
+        off_t keep = static_cast<off_t>(sizeof(header) );
+
+        if(statbuf.st_size > 0)
+        {
+            const size_t size = static_cast<size_t>(statbuf.st_size);
+            void *const ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, checkpoint.fd, 0);
+            checkError2(ptr, MAP_FAILED, "mmap error");
+            checkError(madvise(ptr, size, MADV_SEQUENTIAL), 0, "madvise error");
+            const char *const data = static_cast<const char *>(ptr);
+            assertWithMsg(size >= sizeof(header), "Checkpoint file too short");
+            memcpy(&header, data, sizeof(header) );
+            assertWithMsg(header.magic == CHECKPOINT_MAGIC && header.version == CHECKPOINT_VERSION && header.chunk_size == sizeof(CheckpointChunk) &&
+                header.commit_size == sizeof(CheckpointCommit), "Not a checkpoint file of this version");
+
+            // everything up to the last commit counts
+            CheckpointChunk chunk;
+            size_t offset = sizeof(header);
+            while(checkpoint_chunk_valid(data + offset, size - offset, chunk) == true)
+            {
+                offset += sizeof(chunk) + checkpoint_padded(static_cast<size_t>(chunk.count) * checkpoint_element_size(chunk.kind) );
+                if(chunk.kind == CHECKPOINT_COMMIT)
+                {
+                    keep = static_cast<off_t>(offset);
+                    memcpy(&checkpoint.last_commit, data + offset - sizeof(CheckpointCommit), sizeof(CheckpointCommit) );
+                }
+            }
+
+            offset = sizeof(header);
+            while(offset < static_cast<size_t>(keep) )
+            {
+                memcpy(&chunk, data + offset, sizeof(chunk) );
+                const char *const payload = data + offset + sizeof(chunk);
+                for(DataModel &model : snapshots.models)
+                {
+                    if(chunk.kind == CHECKPOINT_COMMIT)
+                    {
+                        continue;
+                    }
+                    if(chunk.mode == static_cast<uint8_t>(ModeType::COUNT_MODE) )
+                    {
+                        checkpoint_apply(model.count_mode, chunk, payload);
+                    }
+                    else
+                    {
+                        checkpoint_apply(model.fit_test_mode, chunk, payload);
+                    }
+                }
+                offset += sizeof(chunk) + checkpoint_padded(static_cast<size_t>(chunk.count) * checkpoint_element_size(chunk.kind) );
+            }
+            checkError(munmap(ptr, size), 0, "munmap error");
+        }
+
+        size_t samples = 0;
+        for(DataModel &model : snapshots.models)
+        {
+            if(options.compact_history == true)
+            {
+                checkpoint_size_compact(model.count_mode);
+                checkpoint_size_compact(model.fit_test_mode);
+            }
+            checkpoint_check(model.count_mode);
+            checkpoint_check(model.fit_test_mode);
+            if(checkpoint.last_commit.sequence > 0)
+            {
+                model.count_mode.x_axis_max = checkpoint.last_commit.x_axis_max[static_cast<size_t>(ModeType::COUNT_MODE)];
+                model.fit_test_mode.x_axis_max = checkpoint.last_commit.x_axis_max[static_cast<size_t>(ModeType::FIT_TEST_MODE)];
+            }
+        }
+        checkpoint.live_bytes = checkpoint_mark(snapshots.models[0].count_mode) + checkpoint_mark(snapshots.models[0].fit_test_mode);
+        for(size_t mode_index = 0; mode_index < MODE_COUNT; mode_index++)
+        {
+            for(size_t channel = 0; channel < MAX_CHANNEL_COUNT; channel++)
+            {
+                samples += checkpoint.marks[mode_index][channel].samples;
+            }
+        }
+        if(checkpoint.last_commit.sequence > 0 && checkpoint.last_commit.mode < MODE_COUNT)
+        {
+            mode = static_cast<ModeType>(checkpoint.last_commit.mode);
+            ViewState &view = views[checkpoint.last_commit.mode];
+            view.zoomed = (checkpoint.last_commit.zoomed != 0);
+            view.x_begin = checkpoint.last_commit.x_begin;
+            view.x_end = checkpoint.last_commit.x_end;
+        }
+
+        if(keep < statbuf.st_size)
+        {
+            checkError(ftruncate(checkpoint.fd, keep), 0, "ftruncate error");
+        }
+        if(keep > statbuf.st_size)
+        {
+            // new or empty file
+            header = {.magic = CHECKPOINT_MAGIC, .version = CHECKPOINT_VERSION, .chunk_size = sizeof(CheckpointChunk), .commit_size = sizeof(CheckpointCommit)};
+            writeFully(checkpoint.fd, &header, sizeof(header) );
+        }
+        checkError(fdatasync(checkpoint.fd), 0, "fdatasync error");
+        checkpoint.file_size = lseek(checkpoint.fd, 0, SEEK_END);
+        checkError2(checkpoint.file_size, static_cast<off_t>(-1), "lseek error");
+        if(samples > 0)
+        {
+            printf("restored %zu samples from %s in %.1f ms\n", samples, options.checkpoint_path, (monotonic_seconds() - start) * 1000.0);
+        }
+    }
+
+    static bool checkpoint_quit(void)
+    {
+        return checkpoint.quit;
+    }
+
+    static void checkpoint_thread(void)
+    {
+        std::unique_lock<std::mutex> lock(checkpoint.mutex);
+        for(;;)
+        {
+            checkpoint.wakeup.wait_for(lock, std::chrono::milliseconds(options.checkpoint_interval_ms), checkpoint_quit);
+            if(checkpoint.quit == true)
+            {
+                break;
+            }
+            lock.unlock();
+            checkpoint_write();
+            lock.lock();
+        }
+    }
+
+    // After the ingest thread is gone: the checkpoint thread may have kept
+    // the last records from being published, so publish them and write the
+    // final checkpoint here.
+    static void checkpoint_close(std::thread &thread)
+    {
+        {
+            const std::lock_guard<std::mutex> lock_mutex(checkpoint.mutex);
+            checkpoint.quit = true;
+        }
+        checkpoint.wakeup.notify_one();
+        thread.join();
+        snapshot_publish();
+        checkpoint_write();
+        checkError(close(checkpoint.fd), 0, "close error");
+        checkpoint.fd = -1;
+    }
+
+    static inline bool stream_server_enabled(void)
+    {
+        return options.stream_socket_path != NULL || options.stream_port != 0;
+    }
+
+    // called by the serial thread after each published record, never blocks
+    static inline void stream_server_notify(void)
+    {
+        if(stream_server_enabled() == false)
+        {
+            return;
+        }
+        const uint64_t one = 1;
+        const ssize_t ret = write(stream_server.event_fd, &one, sizeof(one) );
+        if(ret == -1 && errno != EAGAIN)
+        {
+            checkError2(ret, -1L, "write error");
+        }
+    }
+
+    static void stream_client_set_want_write(StreamClient &client, const bool want_write)
+    {
+        if(client.want_write == want_write)
+        {
+            return;
+        }
+        epoll_event event;
+        memset(&event, 0, sizeof(event) );
+        event.events = EPOLLIN | EPOLLRDHUP | (want_write ? static_cast<uint32_t>(EPOLLOUT) : 0U);
+        event.data.fd = client.fd;
+        checkError(epoll_ctl(stream_server.epoll_fd, EPOLL_CTL_MOD, client.fd, &event), 0, "epoll_ctl error");
+        client.want_write = want_write;
+    }
+
+    // returns false if the client has to be disconnected
+    static bool stream_client_enqueue(StreamClient &client, const StreamFrame &frame)
+    {
+        const size_t capacity = client.frames.size();
+        if(client.count == capacity)
+        {
+            if(options.stream_policy == SlowClientPolicy::DISCONNECT)
+            {
+                return false;
+            }
+            // drop the oldest frame that has not started to go out
+            if(client.head_offset > 0)
+            {
+                client.frames[(client.head + 1) % capacity] = client.frames[client.head];
+            }
+            client.head = (client.head + 1) % capacity;
+            client.count--;
+            client.dropped++;
+        }
+        client.frames[(client.head + client.count) % capacity] = frame;
+        client.count++;
+        return true;
+    }
+
+    // sends as much of the queue as the socket takes, up to 64 frames per sendmsg
+    static bool stream_client_flush(StreamClient &client)
+    {
+        const size_t capacity = client.frames.size();
+        while(client.count > 0)
+        {
+            iovec iov[64];
+            size_t iov_count = 0;
+            for(size_t i = 0, index = client.head; i < client.count && iov_count < sizeof(iov) / sizeof(iov[0]); i++, index = (index + 1) % capacity)
+            {
+                const size_t offset = (i == 0) ? client.head_offset : 0;
+                iov[iov_count].iov_base = reinterpret_cast<char *>(&client.frames[index]) + offset;
+                iov[iov_count].iov_len = sizeof(StreamFrame) - offset;
+                iov_count++;
+            }
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg) );
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iov_count;
+            const ssize_t ret = sendmsg(client.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if(ret == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            else if(ret == -1 && (errno == EAGAIN) )
+            {
+                break;
+            }
+            else if(ret == -1)
+            {
+                return false;
+            }
+            size_t sent = static_cast<size_t>(ret);
+            while(sent > 0)
+            {
+                const size_t remaining = sizeof(StreamFrame) - client.head_offset;
+                if(sent < remaining)
+                {
+                    client.head_offset += sent;
+                    break;
+                }
+                sent -= remaining;
+                client.head_offset = 0;
+                client.head = (client.head + 1) % capacity;
+                client.count--;
+            }
+        }
+        stream_client_set_want_write(client, client.count > 0);
+        return true;
+    }
+
+    static void stream_client_close(const size_t index)
+    {
+        StreamClient *const client = stream_server.clients[index];
+        if(client->dropped > 0)
+        {
+            printf("stream client %d closed, %llu frames dropped\n", client->fd, client->dropped);
+        }
+        checkError(epoll_ctl(stream_server.epoll_fd, EPOLL_CTL_DEL, client->fd, NULL), 0, "epoll_ctl error");
+        checkError(close(client->fd), 0, "close error");
+        delete client;
+        stream_server.clients[index] = stream_server.clients.back();
+        stream_server.clients.pop_back();
+    }
+
+    static void stream_server_accept(const int listen_fd)
+    {
+        for(;;)
+        {
+            const int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd == -1 && (errno == EINTR || errno == ECONNABORTED) )
+            {
+                continue;
+            }
+            else if(fd == -1 && (errno == EAGAIN) )
+            {
+                break;
+            }
+            else if(fd == -1)
+            {
+                // out of descriptors or memory, the client can retry later
+                perror("accept4 error");
+                break;
+            }
+
+            StreamClient *const client = new StreamClient();
+            client->fd = fd;
+            client->frames.resize(options.stream_queue_frames);
+            client->head = 0;
+            client->count = 0;
+            client->head_offset = 0;
+            client->want_write = false;
+            client->dropped = 0;
+
+            epoll_event event;
+            memset(&event, 0, sizeof(event) );
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.fd = fd;
+            checkError(epoll_ctl(stream_server.epoll_fd, EPOLL_CTL_ADD, fd, &event), 0, "epoll_ctl error");
+            stream_server.clients.push_back(client);
+
+            StreamFrame frame;
+            memset(&frame, 0, sizeof(frame) );
+            frame.type = STREAM_FRAME_HELLO;
+            frame.version = STREAM_FRAME_VERSION;
+            frame.length = sizeof(StreamHello);
+            frame.payload.hello.instance_index = instance.instance_index;
+            frame.payload.hello.epoch = stream_server.cursor.epoch;
+            stream_client_enqueue(*client, frame);
+        }
+    }
+
+    static void stream_thread(void)
+    {
+        epoll_event events[32];
+        char discard[256];
+        StreamFrame frame;
+
+        memset(&frame, 0, sizeof(frame) );
+        frame.type = STREAM_FRAME_RECORD;
+        frame.version = STREAM_FRAME_VERSION;
+        frame.length = sizeof(LiveRecord);
+
+        while(stream_server.quit.load(std::memory_order_seq_cst) == false)
+        {
+            const int event_count = epoll_wait(stream_server.epoll_fd, events, sizeof(events) / sizeof(events[0]), 100);
+            if(event_count == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            checkError2(event_count, -1, "epoll_wait error");
+
+            for(int i = 0; i < event_count; i++)
+            {
+                const int fd = events[i].data.fd;
+                if(fd == stream_server.event_fd)
+                {
+                    uint64_t count;
+                    const ssize_t ret = read(stream_server.event_fd, &count, sizeof(count) );
+                    if(ret == -1 && errno != EAGAIN)
+                    {
+                        checkError2(ret, -1L, "read error");
+                    }
+                    continue;
+                }
+                else if(fd == stream_server.unix_fd || fd == stream_server.tcp_fd)
+                {
+                    stream_server_accept(fd);
+                    continue;
+                }
+
+                for(size_t j = 0; j < stream_server.clients.size(); j++)
+                {
+                    StreamClient &client = *stream_server.clients[j];
+                    if(client.fd != fd)
+                    {
+                        continue;
+                    }
+                    bool keep = (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP) ) == 0;
+                    if(keep == true && (events[i].events & EPOLLIN) != 0)
+                    {
+                        // clients have nothing to say, only end of stream matters
+                        const ssize_t ret = recv(fd, discard, sizeof(discard), MSG_DONTWAIT);
+                        keep = (ret > 0 || (ret == -1 && (errno == EAGAIN || errno == EINTR) ) );
+                    }
+                    if(keep == true && (events[i].events & EPOLLOUT) != 0)
+                    {
+                        keep = stream_client_flush(client);
+                    }
+                    if(keep == false)
+                    {
+                        stream_client_close(j);
+                    }
+                    break;
+                }
+            }
+
+            // fan out everything published since the last pass, then send in batches
+            bool has_records = false;
+            while(live_feed_read(live_feed, &stream_server.cursor, &frame.payload.record) == true)
+            {
+                has_records = true;
+                for(size_t j = 0; j < stream_server.clients.size(); )
+                {
+                    if(stream_client_enqueue(*stream_server.clients[j], frame) == false)
+                    {
+                        printf("stream client %d disconnected, queue full\n", stream_server.clients[j]->fd);
+                        stream_client_close(j);
+                        continue;
+                    }
+                    j++;
+                }
+            }
+            for(size_t j = 0; j < stream_server.clients.size(); )
+            {
+                StreamClient &client = *stream_server.clients[j];
+                if( (has_records == true || client.count > 0) && client.want_write == false && stream_client_flush(client) == false)
+                {
+                    stream_client_close(j);
+                    continue;
+                }
+                j++;
+            }
+        }
+
+        while(stream_server.clients.empty() == false)
+        {
+            stream_client_close(stream_server.clients.size() - 1);
+        }
+    }
+
+    static int stream_server_listen(const int domain, const sockaddr *const address, const socklen_t address_length)
+    {
+        const int fd = socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        checkError2(fd, -1, "socket error");
+        if(domain == AF_INET)
+        {
+            const int enable = 1;
+            checkError(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable) ), 0, "setsockopt error");
+        }
+        checkError(bind(fd, address, address_length), 0, "bind error");
+        checkError(listen(fd, 16), 0, "listen error");
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event) );
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        checkError(epoll_ctl(stream_server.epoll_fd, EPOLL_CTL_ADD, fd, &event), 0, "epoll_ctl error");
+        return fd;
+    }
+
+    static void init_stream_server(void)
+    {
+        stream_server.epoll_fd = -1;
+        stream_server.event_fd = -1;
+        stream_server.unix_fd = -1;
+        stream_server.tcp_fd = -1;
+        stream_server.quit.store(false, std::memory_order_seq_cst);
+        if(stream_server_enabled() == false)
+        {
+            return;
+        }
+
+        // new clients only get records published after the server started
+        stream_server.cursor.epoch = live_feed->epoch;
+        stream_server.cursor.next = live_feed->head.load(std::memory_order_acquire);
+        stream_server.cursor.lost = 0;
+        stream_server.cursor.closed = false;
+
+        stream_server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        checkError2(stream_server.epoll_fd, -1, "epoll_create1 error");
+        stream_server.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        checkError2(stream_server.event_fd, -1, "eventfd error");
+        epoll_event event;
+        memset(&event, 0, sizeof(event) );
+        event.events = EPOLLIN;
+        event.data.fd = stream_server.event_fd;
+        checkError(epoll_ctl(stream_server.epoll_fd, EPOLL_CTL_ADD, stream_server.event_fd, &event), 0, "epoll_ctl error");
+
+        if(options.stream_socket_path != NULL)
+        {
+            sockaddr_un address;
+            struct stat statbuf;
+            memset(&address, 0, sizeof(address) );
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, options.stream_socket_path, sizeof(address.sun_path) - 1);
+            // replace a socket left behind by an earlier run, but nothing else
+            if(lstat(options.stream_socket_path, &statbuf) == 0 && S_ISSOCK(statbuf.st_mode) )
+            {
+                checkError(unlink(options.stream_socket_path), 0, "unlink error");
+            }
+            stream_server.unix_fd = stream_server_listen(AF_UNIX, reinterpret_cast<const sockaddr *>(&address), sizeof(address) );
+            checkError(chmod(options.stream_socket_path, S_IRUSR | S_IWUSR), 0, "chmod error");
+        }
+        if(options.stream_port != 0)
+        {
+            sockaddr_in address;
+            memset(&address, 0, sizeof(address) );
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<uint16_t>(options.stream_port) );
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            stream_server.tcp_fd = stream_server_listen(AF_INET, reinterpret_cast<const sockaddr *>(&address), sizeof(address) );
+        }
+    }
+
+    static void stream_server_close(std::thread &thread)
+    {
+        if(stream_server_enabled() == false)
+        {
+            return;
+        }
+        stream_server.quit.store(true, std::memory_order_seq_cst);
+        stream_server_notify();
+        thread.join();
+
+        if(stream_server.unix_fd != -1)
+        {
+            checkError(close(stream_server.unix_fd), 0, "close error");
+            checkError(unlink(options.stream_socket_path), 0, "unlink error");
+        }
+        if(stream_server.tcp_fd != -1)
+        {
+            checkError(close(stream_server.tcp_fd), 0, "close error");
+        }
+        checkError(close(stream_server.event_fd), 0, "close error");
+        checkError(close(stream_server.epoll_fd), 0, "close error");
+    }
+
+    static void jitter_stats_init(void)
+    {
+        jitter_stats.enabled = (options.jitter_report == true || options.realtime == true);
+        if(jitter_stats.enabled == false)
+        {
+            return;
+        }
+        for(size_t i = 0; i < MODE_COUNT; i++)
+        {
+            for(size_t j = 0; j < MAX_CHANNEL_COUNT; j++)
+            {
+                jitter_stats.series[i][j].last_timestamp = -1.0;
+                jitter_stats.series[i][j].count = 0;
+                jitter_stats.series[i][j].intervals.assign(JITTER_CAPACITY, 0.0);
+            }
+        }
+    }
+
+    static inline void jitter_stats_record(const LiveRecord &record)
+    {
+        if(jitter_stats.enabled == false)
+        {
+            return;
+        }
+        JitterStats::Series &series = jitter_stats.series[record.mode][record.channel];
+        if(series.last_timestamp >= 0.0)
+        {
+            series.intervals[series.count % JITTER_CAPACITY] = record.timestamp - series.last_timestamp;
+            series.count++;
+        }
+        series.last_timestamp = record.timestamp;
+    }
+
+    static inline double sorted_percentile(const std::vector<double> &sorted, const double fraction)
+    {
+        return sorted[static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5)];
+    }
+
+    // Deviation of every interval from the median interval of its series, so
+    // the report does not depend on how often the instrument sends a record.
+    static void jitter_stats_report(FILE *const file)
+    {
+        static const double bucket_bounds[] = {10e-6, 100e-6, 1e-3, 10e-3, 100e-3};
+        static const char *const bucket_names[] = {"<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms"};
+        constexpr const size_t BUCKET_COUNT = sizeof(bucket_bounds) / sizeof(bucket_bounds[0]) + 1;
+
+        if(jitter_stats.enabled == false)
+        {
+            return;
+        }
+        fprintf(file, "timestamp jitter, deviation of the record interval from its median:\n");
+        for(size_t i = 0; i < MODE_COUNT; i++)
+        {
+            const size_t channel_count = (i == static_cast<size_t>(ModeType::COUNT_MODE) ) ?
+                static_cast<size_t>(CountModeChannels::CHANNEL_COUNT) : static_cast<size_t>(FitTestModeChannels::CHANNEL_COUNT);
+            for(size_t j = 0; j < channel_count; j++)
+            {
+                const JitterStats::Series &series = jitter_stats.series[i][j];
+                const size_t count = std::min(series.count, JITTER_CAPACITY);
+                if(count < 2)
+                {
+                    continue;
+                }
+                std::vector<double> deviations(series.intervals.begin(), series.intervals.begin() + static_cast<ptrdiff_t>(count) );
+                std::sort(deviations.begin(), deviations.end() );
+                const double median = sorted_percentile(deviations, 0.5);
+                size_t buckets[BUCKET_COUNT] = {0};
+                for(double &deviation : deviations)
+                {
+                    deviation = fabs(deviation - median);
+                    size_t bucket = 0;
+                    while(bucket < BUCKET_COUNT - 1 && deviation >= bucket_bounds[bucket])
+                    {
+                        bucket++;
+                    }
+                    buckets[bucket]++;
+                }
+                std::sort(deviations.begin(), deviations.end() );
+                const char *const label = (i == static_cast<size_t>(ModeType::COUNT_MODE) ) ? CountModeChannels::descriptors[j].label : FitTestModeChannels::descriptors[j].label;
+                fprintf(file, "  %s: %zu intervals, median %.6f s, deviation p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n   ",
+                    label, count, median, sorted_percentile(deviations, 0.5) * 1e6, sorted_percentile(deviations, 0.9) * 1e6,
+                    sorted_percentile(deviations, 0.99) * 1e6, sorted_percentile(deviations, 0.999) * 1e6, deviations.back() * 1e6);
+                for(size_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+                {
+                    fprintf(file, " %s %zu", bucket_names[bucket], buckets[bucket]);
+                }
+                fprintf(file, "\n");
+            }
+        }
+    }
+
+    // pthread functions return the error instead of setting errno
+    static inline void checkPthreadError(const int ret, const char *const msg)
+    {
+        if(ret != 0)
+        {
+            errno = ret;
+            checkError(ret, 0, msg);
+        }
+    }
+
+    // --realtime: run the calling serial thread SCHED_FIFO, optionally pinned,
+    // and touch its stack so a page fault cannot delay a timestamp
+    static void init_realtime_thread(void)
+    {
+        if(options.realtime_cpu >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(static_cast<size_t>(options.realtime_cpu), &set);
+            checkPthreadError(pthread_setaffinity_np(pthread_self(), sizeof(set), &set), "pthread_setaffinity_np error");
+        }
+        sched_param param;
+        memset(&param, 0, sizeof(param) );
+        param.sched_priority = options.realtime_priority;
+        checkPthreadError(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param), "pthread_setschedparam error");
+
+        volatile char stack[REALTIME_STACK_PREFAULT];
+        for(size_t i = 0; i < sizeof(stack); i += 4096)
+        {
+            stack[i] = 0;
+        }
+    }
+
+    static inline bool alarm_enabled(void)
+    {
+        return options.alarm_ambient_min > 0.0 || options.alarm_fit_factor_min > 0.0;
+    }
+
+    static inline void latency_stats_add(LatencyStats &stats, const double latency)
+    {
+        stats.count++;
+        stats.sum += latency;
+        stats.max = fmax(stats.max, latency);
+    }
+
+    // Serial thread, on every parsed record. An alarm is raised when its rule
+    // starts failing and cleared by the next record of the channel that passes.
+    static void alarm_evaluate(const LiveRecord &record)
+    {
+        if(alarm_enabled() == false || record.mode != static_cast<uint8_t>(ModeType::FIT_TEST_MODE) )
+        {
+            return;
+        }
+        uint8_t rule;
+        double threshold;
+        if(record.channel == FitTestModeChannels::AMBIENT)
+        {
+            rule = LIVE_ALARM_AMBIENT_LOW;
+            threshold = options.alarm_ambient_min;
+        }
+        else if(record.channel == FitTestModeChannels::FIT_FACTOR)
+        {
+            rule = LIVE_ALARM_FIT_FACTOR_LOW;
+            threshold = options.alarm_fit_factor_min;
+        }
+        else
+        {
+            return;
+        }
+        if(threshold <= 0.0)
+        {
+            return;
+        }
+
+        const bool failing = (record.reading < threshold);
+        if(failing == alarm_state.active[rule])
+        {
+            return;
+        }
+        alarm_state.active[rule] = failing;
+        if(failing == false)
+        {
+            live_feed->alarm_active.fetch_and(~(1U << rule), std::memory_order_release);
+            return;
+        }
+        live_feed->alarm_active.fetch_or(1U << rule, std::memory_order_release);
+        live_feed->alarm_count.fetch_add(1, std::memory_order_release);
+
+        AlarmEvent event;
+        event.rule = rule;
+        event.reading = record.reading;
+        event.timestamp = record.timestamp;
+        event.flag_latency = monotonic_seconds() - record.timestamp;
+        {
+            const std::lock_guard<std::mutex> lock_mutex(alarm_state.mutex);
+            alarm_state.pending.push_back(event);
+        }
+        const uint64_t one = 1;
+        const ssize_t ret = write(alarm_state.event_fd, &one, sizeof(one) );
+        if(ret == -1 && errno != EAGAIN)
+        {
+            checkError2(ret, -1L, "write error");
+        }
+    }
+
+    // alarm thread; the hook gets the alarm in its environment
+    static void alarm_run_hook(const AlarmEvent &event)
+    {
+        char rule_buf[64], reading_buf[64], instance_buf[64];
+        checkError3(snprintf(rule_buf, sizeof(rule_buf), "PORTACOUNT_ALARM=%s", alarm_names[event.rule]), static_cast<int>(sizeof(rule_buf) ), "snprintf error");
+        checkError3(snprintf(reading_buf, sizeof(reading_buf), "PORTACOUNT_ALARM_READING=%g", event.reading), static_cast<int>(sizeof(reading_buf) ), "snprintf error");
+        checkError3(snprintf(instance_buf, sizeof(instance_buf), "PORTACOUNT_INSTANCE=%u", instance.instance_index), static_cast<int>(sizeof(instance_buf) ), "snprintf error");
+
+        std::vector<char *> envp;
+        for(char **env = environ; *env != NULL; env++)
+        {
+            envp.push_back(*env);
+        }
+        envp.push_back(rule_buf);
+        envp.push_back(reading_buf);
+        envp.push_back(instance_buf);
+        envp.push_back(NULL);
+
+        char shell[] = "/bin/sh";
+        char dash_c[] = "-c";
+        char *const argv[] = {shell, dash_c, const_cast<char *>(options.alarm_hook), NULL};
+        // without the signals a --headless daemon blocks in all its threads
+        posix_spawnattr_t attributes;
+        sigset_t no_signals;
+        checkError(posix_spawnattr_init(&attributes), 0, "posix_spawnattr_init error");
+        checkError(sigemptyset(&no_signals), 0, "sigemptyset error");
+        checkError(posix_spawnattr_setsigmask(&attributes, &no_signals), 0, "posix_spawnattr_setsigmask error");
+        checkError(posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK), 0, "posix_spawnattr_setflags error");
+        pid_t pid;
+        const int ret = posix_spawn(&pid, shell, NULL, &attributes, argv, envp.data() );
+        checkError(posix_spawnattr_destroy(&attributes), 0, "posix_spawnattr_destroy error");
+        if(ret != 0)
+        {
+            errno = ret;
+            perror("posix_spawn error");
+            return;
+        }
+        alarm_state.hook_pid = pid;
+        alarm_state.hook_started = monotonic_seconds();
+        latency_stats_add(alarm_state.hook_latency, alarm_state.hook_started - event.timestamp);
+        if(alarm_state.hook_started - event.timestamp > static_cast<double>(options.alarm_deadline_ms) * 0.001)
+        {
+            alarm_state.late++;
+        }
+    }
+
+    // alarm thread: reap the hook, or kill it once it ran past the hook timeout
+    static void alarm_reap_hook(void)
+    {
+        if(alarm_state.hook_pid == 0)
+        {
+            return;
+        }
+        int flags = WNOHANG;
+        if(monotonic_seconds() - alarm_state.hook_started > static_cast<double>(options.alarm_hook_timeout_ms) * 0.001)
+        {
+            checkError(kill(alarm_state.hook_pid, SIGKILL), 0, "kill error");
+            alarm_state.killed++;
+            flags = 0;
+        }
+        const pid_t ret = waitpid(alarm_state.hook_pid, NULL, flags);
+        checkError2(ret, static_cast<pid_t>(-1), "waitpid error");
+        if(ret != 0)
+        {
+            alarm_state.hook_pid = 0;
+        }
+    }
+
+    static void alarm_thread(void)
+    {
+        std::vector<AlarmEvent> events;
+        for(;;)
+        {
+            pollfd poll_fd = {alarm_state.event_fd, POLLIN, 0};
+            // while a hook runs, wake up to enforce its timeout
+            const int timeout = (alarm_state.hook_pid != 0) ? 50 : -1;
+            const int ret = poll(&poll_fd, 1, timeout);
+            if(ret == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            checkError2(ret, -1, "poll error");
+            if(ret > 0)
+            {
+                uint64_t value;
+                checkError2(read(alarm_state.event_fd, &value, sizeof(value) ), -1L, "read error");
+            }
+            alarm_reap_hook();
+            if(alarm_state.quit.load() == true)
+            {
+                break;
+            }
+            {
+                const std::lock_guard<std::mutex> lock_mutex(alarm_state.mutex);
+                events.swap(alarm_state.pending);
+            }
+            for(const AlarmEvent &event : events)
+            {
+                latency_stats_add(alarm_state.flag_latency, event.flag_latency);
+                if(options.alarm_hook != NULL)
+                {
+                    if(alarm_state.hook_pid != 0)
+                    {
+                        alarm_state.suppressed++;
+                    }
+                    else
+                    {
+                        alarm_run_hook(event);
+                    }
+                }
+                // audible alert on the terminal
+                printf("\aalarm %s: reading %g, flag after %.1f us\n", alarm_names[event.rule], event.reading, event.flag_latency * 1e6);
+            }
+            events.clear();
+        }
+        // a running hook gets the rest of its timeout
+        while(alarm_state.hook_pid != 0)
+        {
+            sleepMicroseconds(50000);
+            alarm_reap_hook();
+        }
+    }
+
+    static void init_alarms(void)
+    {
+        alarm_state.event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        checkError2(alarm_state.event_fd, -1, "eventfd error");
+        alarm_state.quit.store(false);
+        alarm_state.hook_pid = 0;
+    }
+
+    static void alarm_close(std::thread &thread)
+    {
+        if(alarm_enabled() == false)
+        {
+            return;
+        }
+        alarm_state.quit.store(true);
+        const uint64_t one = 1;
+        checkError2(write(alarm_state.event_fd, &one, sizeof(one) ), -1L, "write error");
+        thread.join();
+        checkError(close(alarm_state.event_fd), 0, "close error");
+
+        if(alarm_state.flag_latency.count > 0)
+        {
+            printf("alarm latency: %llu alarms, flag mean %.1f us max %.1f us", alarm_state.flag_latency.count,
+                alarm_state.flag_latency.sum / static_cast<double>(alarm_state.flag_latency.count) * 1e6, alarm_state.flag_latency.max * 1e6);
+            if(alarm_state.hook_latency.count > 0)
+            {
+                printf(", hook start mean %.1f us max %.1f us", alarm_state.hook_latency.sum / static_cast<double>(alarm_state.hook_latency.count) * 1e6,
+                    alarm_state.hook_latency.max * 1e6);
+            }
+            printf(", %llu late, %llu suppressed, %llu killed\n", alarm_state.late, alarm_state.suppressed, alarm_state.killed);
+        }
+    }
+
+    // Averages a count mode reading into the newest queued record of the same
+    // channel. Fit-test records are single measurements and never merged.
+    static bool ingest_queue_coalesce(const LiveRecord &record)
+    {
+        if(ingest_queue.record_queue.empty() == true || record.mode != static_cast<uint8_t>(ModeType::COUNT_MODE) )
+        {
+            return false;
+        }
+        MutexQueue::QueuedRecord &newest = ingest_queue.record_queue.back();
+        if(newest.record.mode != record.mode || newest.record.channel != record.channel)
+        {
+            return false;
+        }
+        const double weight = static_cast<double>(newest.weight);
+        newest.record.reading = (newest.record.reading * weight + record.reading) / (weight + 1.0);
+        newest.record.timestamp = record.timestamp;
+        newest.record.flags = static_cast<uint8_t>(record.flags & ~SAMPLE_FLAG_ZERO_CLAMPED);
+        newest.record.value = reading_to_value(CountModeChannels::descriptors[record.channel], newest.record.reading, newest.record.flags);
+        newest.weight++;
+        return true;
+    }
+
+    // serial thread
+    static void ingest_queue_push(const LiveRecord &record)
+    {
+        {
+            std::unique_lock<std::mutex> lock(ingest_queue.queue_mutex);
+            if(ingest_queue.record_queue.size() >= options.ingest_queue_records)
+            {
+                switch(options.ingest_policy)
+                {
+                    case IngestPolicy::BLOCK:
+                        ingest_queue.space.wait(lock, [](){ return ingest_queue.record_queue.size() < options.ingest_queue_records; });
+                        break;
+
+                    case IngestPolicy::COALESCE:
+                        if(ingest_queue_coalesce(record) == true)
+                        {
+                            ingest_queue.coalesced.fetch_add(1, std::memory_order_relaxed);
+                            PORTACOUNT_PROBE2(record_drop, record.sequence, 1);
+                            return;
+                        }
+                        // nothing to merge with, fall back to dropping
+                        PORTACOUNT_PROBE2(record_drop, ingest_queue.record_queue.front().record.sequence, 0);
+                        ingest_queue.record_queue.pop();
+                        ingest_queue.dropped.fetch_add(1, std::memory_order_relaxed);
+                        break;
+
+                    case IngestPolicy::DROP_OLDEST:
+                        PORTACOUNT_PROBE2(record_drop, ingest_queue.record_queue.front().record.sequence, 0);
+                        ingest_queue.record_queue.pop();
+                        ingest_queue.dropped.fetch_add(1, std::memory_order_relaxed);
+                        break;
+                }
+            }
+            MutexQueue::QueuedRecord queued;
+            queued.record = record;
+            queued.weight = 1;
+            ingest_queue.record_queue.push(queued);
+            PORTACOUNT_PROBE2(record_enqueue, record.sequence, ingest_queue.record_queue.size() );
+        }
+        ingest_queue.wakeup.notify_one();
+    }
+
+    // serial thread, never blocks
+    static void fleet_log_append(const MutexQueue::StringBuffer &record)
+    {
+        static_assert(sizeof(record.buf) <= FLEET_LINE_SIZE, "Line does not fit a fleet log slot");
+        uint64_t position = fleet_log.header->head.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            FleetLogSlot &slot = fleet_log.slots[position & (FLEET_LOG_CAPACITY - 1)];
+            const uint64_t free_state = position / FLEET_LOG_CAPACITY * 2;
+            const uint64_t state = slot.state.load(std::memory_order_acquire);
+            if(state == free_state)
+            {
+                if(fleet_log.header->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed) == true)
+                {
+                    slot.line.timestamp = record.timestamp;
+                    slot.line.source = instance.instance_index;
+                    slot.line.length = static_cast<uint32_t>(record.size);
+                    memcpy(slot.line.text, record.buf, record.size);
+                    slot.state.store(free_state + 1, std::memory_order_release);
+                    return;
+                }
+            }
+            else if(state < free_state)
+            {
+                // the line of the previous lap is still waiting for the drainer
+                fleet_log.header->dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+            {
+                position = fleet_log.header->head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // log, echo, publish and queue one framed line
+    static void publish_record(const MutexQueue::StringBuffer &record)
+    {
+        char stringbuf[128];
+
+        memset(stringbuf, 0, sizeof(stringbuf));
+        const int str_len = snprintf(stringbuf, sizeof(stringbuf) - 1, "%20.9f: ", record.timestamp);
+        static_assert(static_cast<int>(sizeof(stringbuf) - 1) == sizeof(stringbuf) - 1, "Size overflow"); 
+        checkError3(str_len, static_cast<int>(sizeof(stringbuf) - 1), "snprintf error");
+        printf("%s", record.buf);
+        log_writer_append(stringbuf, static_cast<size_t>(str_len), record.buf, record.size);
+        if(fleet_log.header != NULL)
+        {
+            fleet_log_append(record);
+        }
+
+        LiveRecord live_record;
+        if(parse_live_record<CountModeChannels>(record.buf, record.timestamp, live_record) == false &&
+            parse_live_record<FitTestModeChannels>(record.buf, record.timestamp, live_record) == false)
+        {
+            return;
+        }
+        // the number live_feed_publish gives it, so probes, queue and feed agree
+        live_record.sequence = live_feed->head.load(std::memory_order_relaxed);
+        PORTACOUNT_PROBE4(record_parsed, live_record.sequence, probe_ns(live_record.timestamp), live_record.mode, live_record.channel);
+        jitter_stats_record(live_record);
+        if(options.rollups == true)
+        {
+            rollup_add(live_record);
+        }
+        alarm_evaluate(live_record);
+        live_feed_publish(live_feed, live_record);
+        stream_server_notify();
+        ingest_queue_push(live_record);
     }
 
-    static inline std::tuple<double, double, bool> compute_y_axis(const double min, const double max, const double default_min, const double default_max)
+    // ingest thread with the queue mutex held: arrival of the oldest record
+    // the GUI cannot see yet, 0 if there is none
+    static double snapshot_pending_since(void)
     {
-        double y_axis_min = floor(min);
-        double y_axis_max = ceil(max);
-        bool default_used = false;
-        if(y_axis_max < y_axis_min)
+        const unsigned long long applied = snapshots.applied[snapshots.active.load(std::memory_order_relaxed)];
+        if(applied < snapshots.log_begin + snapshots.log.size() )
         {
-            y_axis_min = default_min;
-            y_axis_max = default_max;
-            default_used = true;
+            return snapshots.log[static_cast<size_t>(applied - snapshots.log_begin)].record.timestamp;
         }
-        if(y_axis_max - y_axis_min < 1.0)
+        if(ingest_queue.record_queue.empty() == false)
         {
-            y_axis_max = y_axis_min + 1.0;
+            return ingest_queue.record_queue.front().record.timestamp;
         }
-        return std::make_tuple(y_axis_min, y_axis_max, default_used);
+        return 0.0;
     }
 
-    static void display(void) 
+    static void geometry_notify(void)
     {
-        // check if there have been any openGL problems
-        const GLenum errCode = glGetError();
-        if(errCode != GL_NO_ERROR) 
         {
-            const GLubyte* errString = gluErrorString(errCode);
-            fprintf(stderr, "OpenGL error: %s\n", errString);
+            const std::lock_guard<std::mutex> lock_mutex(geometry.mutex);
+            geometry.dirty = true;
         }
+        geometry.wakeup.notify_one();
+    }
 
-        // clear the frame buffer
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // set the orthographic projection matrix
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        gluOrtho2D(PROJECTION.LEFT_BOUND, PROJECTION.RIGHT_BOUND, PROJECTION.BOTTOM_BOUND, PROJECTION.TOP_BOUND);
-
-        // set up the camera transformation
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-
-        glColor3d(0.0, 0.0, 0.0);
+    static bool ingest_ready(void)
+    {
+        for(size_t i = 0; i < MODE_COUNT; i++)
+        {
+            if(snapshots.reset_requested[i].load() == true)
+            {
+                return true;
+            }
+        }
+        return ingest_queue.quit == true || ingest_queue.record_queue.empty() == false;
+    }
 
-        constexpr const double axis_x_begin = 0.75;
-        constexpr const double axis_x_end = 10.0;
-        constexpr const double x_axis_inc = 0.5;
-        constexpr const unsigned int x_axis_count = 19;
-        constexpr const double x_axis_count_divisor = static_cast<double>(x_axis_count) - 1.0;
+    // a window, a strip chart and checkpoints need the history, a headless daemon otherwise not
+    static inline bool headless_keeps_history(void)
+    {
+        return options.headless == false || strip_chart_enabled() == true || options.checkpoint_path != NULL;
+    }
 
-        if(mode == ModeType::COUNT_MODE)
+    static void headless_axes_init(void)
+    {
+        for(size_t mode_index = 0; mode_index < MODE_COUNT; mode_index++)
         {
-            constexpr const double axis_y_begin = 0.5;
-            constexpr const double axis_y_end = 10.0;
+            for(size_t channel = 0; channel < MAX_CHANNEL_COUNT; channel++)
+            {
+                headless_axes.min[mode_index][channel] = std::numeric_limits<double>::infinity();
+                headless_axes.max[mode_index][channel] = -std::numeric_limits<double>::infinity();
+            }
+            headless_axes.newest[mode_index] = 0.0;
+        }
+    }
 
-            // draw x-axis
-            draw_vertical_linear_lines(axis_x_begin, x_axis_inc, axis_y_begin, axis_y_end, x_axis_count);
+    // ingest thread, in place of the snapshots
+    static void headless_axes_add(const std::vector<LiveRecord> &batch)
+    {
+        const std::lock_guard<std::mutex> lock_mutex(headless_axes.mutex);
+        for(const LiveRecord &record : batch)
+        {
+            headless_axes.min[record.mode][record.channel] = std::min(headless_axes.min[record.mode][record.channel], record.value);
+            headless_axes.max[record.mode][record.channel] = std::max(headless_axes.max[record.mode][record.channel], record.value);
+            headless_axes.newest[record.mode] = std::max(headless_axes.newest[record.mode], record.timestamp);
+        }
+    }
 
-            // draw y-axis
-            double y_axis_min, y_axis_max;
-            bool default_y_axis;
-            std::tie(y_axis_min, y_axis_max, default_y_axis) = compute_y_axis(count_mode_data.count_array_min, count_mode_data.count_array_max, -3.0, 5.0);
+    // Applies the parsed records of all modes to the data model and publishes
+    // snapshots of it, see SnapshotBuffers. Wakes up on new records and every
+    // INGEST_RETRY_MS to publish ops that waited for the GUI.
+    static void ingest_thread(void)
+    {
+        std::vector<LiveRecord> batch;
+        std::unique_lock<std::mutex> lock(ingest_queue.queue_mutex);
 
-            // synchronize y-axis scales across multiple process instances
-            checkError(sem_wait(semaphore_ptrs[instance.instance_index]), 0, "sem_wait error");
-            std::atomic_thread_fence(std::memory_order_seq_cst);
-            if(default_y_axis == false)
+        for(;;)
+        {
+            ingest_queue.wakeup.wait_for(lock, std::chrono::milliseconds(INGEST_RETRY_MS), ingest_ready);
+            while(ingest_queue.record_queue.empty() == false)
             {
-                shared_memory_ptrs[instance.instance_index]->mode = ModeType::COUNT_MODE;
-                shared_memory_ptrs[instance.instance_index]->count_mode.y_axis_min = y_axis_min;            
-                shared_memory_ptrs[instance.instance_index]->count_mode.y_axis_max = y_axis_max;
-                shared_memory_ptrs[instance.instance_index]->count_mode.y_axis_valid = true;            
-                shared_memory_ptrs[instance.instance_index]->valid = true;
+                batch.push_back(ingest_queue.record_queue.front().record);
+                ingest_queue.record_queue.pop();
+                PORTACOUNT_PROBE2(record_dequeue, batch.back().sequence, ingest_queue.record_queue.size() );
             }
-            std::atomic_thread_fence(std::memory_order_seq_cst);
-            checkError(sem_post(semaphore_ptrs[instance.instance_index]), 0, "sem_post error");
+            const bool quit = ingest_queue.quit;
+            lock.unlock();
+            ingest_queue.space.notify_all();
 
-            for(unsigned int i = 0; i < instance.total_instances; i++)
+            for(size_t i = 0; i < MODE_COUNT; i++)
             {
-                if(i == instance.instance_index)
+                if(snapshots.reset_requested[i].exchange(false) == true)
                 {
-                    continue;
+                    ModelOp op;
+                    memset(&op, 0, sizeof(op) );
+                    op.reset = true;
+                    op.record.mode = static_cast<uint8_t>(i);
+                    op.record.timestamp = monotonic_seconds();
+                    snapshot_log(op);
                 }
-                checkError(sem_wait(semaphore_ptrs[i]), 0, "sem_wait error");
-                std::atomic_thread_fence(std::memory_order_seq_cst);
-                if(shared_memory_ptrs[i]->valid == true && shared_memory_ptrs[i]->mode == ModeType::COUNT_MODE)
+            }
+            if(headless_keeps_history() == false)
+            {
+                headless_axes_add(batch);
+            }
+            else
+            {
+                for(const LiveRecord &record : batch)
                 {
-                    if(shared_memory_ptrs[i]->count_mode.y_axis_valid == true)
-                    {
-                        if(shared_memory_ptrs[i]->count_mode.y_axis_min < y_axis_min)
-                        {
-                            y_axis_min = shared_memory_ptrs[i]->count_mode.y_axis_min;
-                        }
-                        if(shared_memory_ptrs[i]->count_mode.y_axis_max > y_axis_max)
-                        {
-                            y_axis_max = shared_memory_ptrs[i]->count_mode.y_axis_max;
-                        }
-                    }            
+                    ModelOp op;
+                    op.reset = false;
+                    op.record = record;
+                    snapshot_log(op);
                 }
-                std::atomic_thread_fence(std::memory_order_seq_cst);
-                checkError(sem_post(semaphore_ptrs[i]), 0, "sem_post error");
             }
-
-            const unsigned int y_axis_range = static_cast<unsigned int>(rint(y_axis_max - y_axis_min));
-            const double y_axis_inc = 9.3 / static_cast<double>(y_axis_range);
-            draw_horizontal_log10_lines(axis_x_begin, axis_x_end, axis_y_begin, y_axis_inc, y_axis_range);
-
-            // draw x-axis label
-            draw_horizontal_string("Time", 0.002, 4.5, 0.05);
-
-            // draw x-axis ticks
-            char buf[32];
-            for(unsigned int i = 0; i < x_axis_count; i+=2)
-            {
-                memset(buf, 0, sizeof(buf) );
-                const double temp = rint(static_cast<double>(i) / x_axis_count_divisor * count_mode_data.count_mode_x_axis_max);
-                static_assert(static_cast<int>(sizeof(buf) - 1) == sizeof(buf) - 1, "Size overflow");
-                checkError3(snprintf(buf, sizeof(buf) - 1, "%u", static_cast<unsigned int>(temp ) ), static_cast<int>(sizeof(buf) - 1), "snprintf error");
-                draw_horizontal_string(buf, 0.001, axis_x_begin - 0.05 + x_axis_inc * static_cast<double>(i), 0.31);
-            }        
-
-            // draw y-axis label
-            draw_vertical_string("Count", 0.002, 0.25, 4.5);
-
-            // draw y-axis ticks
-            for(unsigned int i = 0; i <= y_axis_range; i++)
+            batch.clear();
+            const unsigned long long version = snapshots.version.load(std::memory_order_relaxed);
+            snapshot_publish();
+            if(snapshots.version.load(std::memory_order_relaxed) != version)
             {
-                memset(buf, 0, sizeof(buf) );
-                static_assert(static_cast<int>(sizeof(buf) - 1) == sizeof(buf) - 1, "Size overflow");
-                checkError3(snprintf(buf, sizeof(buf) - 1, "1e%+d", static_cast<int>(y_axis_min) + static_cast<int>(i) ), static_cast<int>(sizeof(buf) - 1), "snprintf error");
-                draw_horizontal_string(buf, 0.001, 0.3, axis_y_begin + y_axis_inc * static_cast<double>(i) );
-            }        
+                geometry_notify();
+            }
 
-            // draw data points
-            glColor3d(color.R_value, color.G_value, color.B_value);
-            glPointSize(8.0);
-            glBegin(GL_POINTS);
-            const double multiplier = 1.0 / count_mode_data.count_mode_x_axis_max;
-            for(size_t i = 0, size = count_mode_data.count_array.size(); i < size; i++)
+            lock.lock();
+            snapshots.pending_since.store(snapshot_pending_since(), std::memory_order_relaxed);
+            if(quit == true)
             {
-                const double x_coord = static_cast<double>(i) * multiplier * 9.0 + axis_x_begin;
-                const double y_coord = (count_mode_data.count_array[i] - y_axis_min) * y_axis_inc + axis_y_begin;
-                glVertex3d(x_coord, y_coord, 0.1);
+                break;
             }
-            glEnd();
         }
-        else if(mode == ModeType::FIT_TEST_MODE)
-        {
-            constexpr const double axis_y_jump = 3.3;
-
-            constexpr const double ambient_axis_y_begin = 0.5;
-            constexpr const double ambient_axis_y_end = 3.3;
-            constexpr const double sample_axis_y_begin = 0.5 + axis_y_jump;
-            constexpr const double sample_axis_y_end = 3.3 + axis_y_jump;
-            constexpr const double fit_factor_axis_y_begin = 0.5 + axis_y_jump * 2.0;
-            constexpr const double fit_factor_axis_y_end = 3.3 + axis_y_jump * 2.0;
+    }
 
-            // draw x-axis
-            draw_vertical_linear_lines(axis_x_begin, x_axis_inc, ambient_axis_y_begin, ambient_axis_y_end, x_axis_count);
-            draw_vertical_linear_lines(axis_x_begin, x_axis_inc, sample_axis_y_begin, sample_axis_y_end, x_axis_count);
-            draw_vertical_linear_lines(axis_x_begin, x_axis_inc, fit_factor_axis_y_begin, fit_factor_axis_y_end, x_axis_count);
+    static void ingest_close(std::thread &thread)
+    {
+        {
+            const std::lock_guard<std::mutex> lock_mutex(ingest_queue.queue_mutex);
+            ingest_queue.quit = true;
+        }
+        ingest_queue.wakeup.notify_one();
+        thread.join();
+    }
 
-            // draw y-axis
-            double ambient_y_axis_min, ambient_y_axis_max;
-            bool ambient_default_y_axis;
-            std::tie(ambient_y_axis_min, ambient_y_axis_max, ambient_default_y_axis) = compute_y_axis(fit_test_mode_data.ambient_array_min, fit_test_mode_data.ambient_array_max, 3.0, 6.0);
+    static void read_serial_thread(void)
+    {
+        fd_set selector;
+        char read_buf[300];
+        MutexQueue::StringBuffer input_buf;
 
-            double sample_y_axis_min, sample_y_axis_max;
-            bool sample_default_y_axis;
-            std::tie(sample_y_axis_min, sample_y_axis_max, sample_default_y_axis) = compute_y_axis(fit_test_mode_data.sample_array_min, fit_test_mode_data.sample_array_max, -1.0, 3.0);
+        input_buf.size = 0;
 
-            double fit_factor_y_axis_min, fit_factor_y_axis_max;
-            bool fit_factor_default_y_axis;
-            std::tie(fit_factor_y_axis_min, fit_factor_y_axis_max, fit_factor_default_y_axis) = compute_y_axis(fit_test_mode_data.fit_factor_array_min, fit_test_mode_data.fit_factor_array_max, 0.0, 3.0);
+        if(options.realtime == true)
+        {
+            init_realtime_thread();
+        }
 
-            // synchronize y-axis scales across multiple process instances
-            checkError(sem_wait(semaphore_ptrs[instance.instance_index]), 0, "sem_wait error");
+        for(;;)
+        {
             std::atomic_thread_fence(std::memory_order_seq_cst);
-            if(ambient_default_y_axis == false)
-            {
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.ambient_y_axis_min = ambient_y_axis_min;            
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.ambient_y_axis_max = ambient_y_axis_max;
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.ambient_y_axis_valid = true;
-            }
-            if(sample_default_y_axis == false)
-            {
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.sample_y_axis_min = sample_y_axis_min;            
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.sample_y_axis_max = sample_y_axis_max;
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.sample_y_axis_valid = true;
-            }
-            if(fit_factor_default_y_axis == false)
+            if(thread_info.quit.load(std::memory_order_seq_cst) == true)
             {
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.fit_factor_y_axis_min = fit_factor_y_axis_min;            
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.fit_factor_y_axis_max = fit_factor_y_axis_max;
-                shared_memory_ptrs[instance.instance_index]->fit_test_mode.fit_factor_y_axis_valid = true;
+                break;
             }
-            if(ambient_default_y_axis == false || sample_default_y_axis == false || fit_factor_default_y_axis == false)
+
+            ssize_t ret;
+            struct timespec time;
+
+            FD_ZERO(&selector);
+            FD_SET(fds.serial_fd, &selector);
+
+            timeval timeout = {0, 100000};
+            const int ready = select(fds.serial_fd + 1, &selector, NULL, NULL, &timeout);
+            if(ready == -1 && errno == EINTR)
             {
-                shared_memory_ptrs[instance.instance_index]->mode = ModeType::FIT_TEST_MODE;
-                shared_memory_ptrs[instance.instance_index]->valid = true;
+                continue;
             }
-            std::atomic_thread_fence(std::memory_order_seq_cst);
-            checkError(sem_post(semaphore_ptrs[instance.instance_index]), 0, "sem_post error");
-
-            for(unsigned int i = 0; i < instance.total_instances; i++)
+            checkError2(ready, -1, "select error");
+            if(FD_ISSET(fds.serial_fd, &selector) )
             {
-                if(i == instance.instance_index)
-                {
-                    continue;
-                }
-                checkError(sem_wait(semaphore_ptrs[i]), 0, "sem_wait error");
-                std::atomic_thread_fence(std::memory_order_seq_cst);
-                if(shared_memory_ptrs[i]->valid == true && shared_memory_ptrs[i]->mode == ModeType::FIT_TEST_MODE)
+                ret = read(fds.serial_fd, read_buf, sizeof(read_buf) );
+                checkError2(ret, -1L, "read error");
+                if(ret > 0)
                 {
-                    if(shared_memory_ptrs[i]->fit_test_mode.ambient_y_axis_valid == true)
-                    {
-                        if(shared_memory_ptrs[i]->fit_test_mode.ambient_y_axis_min < ambient_y_axis_min)
-                        {
-                            ambient_y_axis_min = shared_memory_ptrs[i]->fit_test_mode.ambient_y_axis_min;
-                        }
-                        if(shared_memory_ptrs[i]->fit_test_mode.ambient_y_axis_max > ambient_y_axis_max)
-                        {
-                            ambient_y_axis_max = shared_memory_ptrs[i]->fit_test_mode.ambient_y_axis_max;
-                        }
-                    }
-                    if(shared_memory_ptrs[i]->fit_test_mode.sample_y_axis_valid == true)
+                    checkError(clock_gettime(CLOCK_MONOTONIC, &time), 0, "clock_gettime error");
+                    double timeval = static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) * 0.000000001;
+                    PORTACOUNT_PROBE2(serial_read, static_cast<uint64_t>(time.tv_sec) * 1000000000ULL + static_cast<uint64_t>(time.tv_nsec), ret);
+
+                    // frame lines, each record is stamped with the arrival time of its last byte
+                    for(size_t i = 0; i < static_cast<size_t>(ret); i++)
                     {
-                        if(shared_memory_ptrs[i]->fit_test_mode.sample_y_axis_min < sample_y_axis_min)
-                        {
-                            sample_y_axis_min = shared_memory_ptrs[i]->fit_test_mode.sample_y_axis_min;
-                        }
-                        if(shared_memory_ptrs[i]->fit_test_mode.sample_y_axis_max > sample_y_axis_max)
+                        input_buf.buf[input_buf.size] = read_buf[i];
+                        input_buf.size++;
+                        if(read_buf[i] == '\n' || input_buf.size == sizeof(input_buf.buf) - 1)
                         {
-                            sample_y_axis_max = shared_memory_ptrs[i]->fit_test_mode.sample_y_axis_max;
+                            input_buf.buf[input_buf.size] = '\0';
+                            input_buf.timestamp = timeval;
+                            PORTACOUNT_PROBE2(line_framed, probe_ns(timeval), input_buf.size);
+                            publish_record(input_buf);
+                            input_buf.size = 0;
                         }
                     }
-                    if(shared_memory_ptrs[i]->fit_test_mode.fit_factor_y_axis_valid == true)
-                    {            
-                        if(shared_memory_ptrs[i]->fit_test_mode.fit_factor_y_axis_min < fit_factor_y_axis_min)
-                        {
-                            fit_factor_y_axis_min = shared_memory_ptrs[i]->fit_test_mode.fit_factor_y_axis_min;
-                        }
-                        if(shared_memory_ptrs[i]->fit_test_mode.fit_factor_y_axis_max > fit_factor_y_axis_max)
-                        {
-                            fit_factor_y_axis_max = shared_memory_ptrs[i]->fit_test_mode.fit_factor_y_axis_max;
-                        }
-                    }            
                 }
-                std::atomic_thread_fence(std::memory_order_seq_cst);
-                checkError(sem_post(semaphore_ptrs[i]), 0, "sem_post error");
             }
+        }
 
-            const unsigned int ambient_y_axis_range = static_cast<unsigned int>(rint(ambient_y_axis_max - ambient_y_axis_min));
-            const double ambient_y_axis_inc = 2.8 / static_cast<double>(ambient_y_axis_range);
-
-            const unsigned int sample_y_axis_range = static_cast<unsigned int>(rint(sample_y_axis_max - sample_y_axis_min));
-            const double sample_y_axis_inc = 2.8 / static_cast<double>(sample_y_axis_range);
-
-            const unsigned int fit_factor_y_axis_range = static_cast<unsigned int>(rint(fit_factor_y_axis_max - fit_factor_y_axis_min));
-            const double fit_factor_y_axis_inc = 2.8 / static_cast<double>(fit_factor_y_axis_range);
-
-            draw_horizontal_log10_lines(axis_x_begin, axis_x_end, ambient_axis_y_begin, ambient_y_axis_inc, ambient_y_axis_range);
-            draw_horizontal_log10_lines(axis_x_begin, axis_x_end, sample_axis_y_begin, sample_y_axis_inc, sample_y_axis_range);
-            draw_horizontal_log10_lines(axis_x_begin, axis_x_end, fit_factor_axis_y_begin, fit_factor_y_axis_inc, fit_factor_y_axis_range);
-
-            // draw x-axis label
-            draw_horizontal_string("Time", 0.002, 4.5, 0.05);
-            draw_horizontal_string("Time", 0.002, 4.5, 0.05 + axis_y_jump);
-            draw_horizontal_string("Time", 0.002, 4.5, 0.05 + axis_y_jump * 2.0);
+        // keep an unterminated last line in the log
+        if(input_buf.size > 0)
+        {
+            input_buf.buf[input_buf.size] = '\0';
+            publish_record(input_buf);
+        }
+    }
 
-            // draw x-axis ticks
-            char buf[32];
-            for(unsigned int i = 0; i < x_axis_count; i+=2)
+    // newest arrival time in store, 0 if it is empty
+    template <class Channels>
+    static double series_store_newest(const SeriesStore<Channels> &store)
+    {
+        double newest = 0.0;
+        for(const typename SeriesStore<Channels>::Series &series : store.series)
+        {
+            if(strip_chart_enabled() == true)
+            {
+                if(series.strip.end > series.strip.begin)
+                {
+                    newest = std::max(newest, series.strip.timestamps[strip_index(series.strip, series.strip.end - 1)]);
+                }
+            }
+            else if(series.timestamps.size > 0)
             {
-                memset(buf, 0, sizeof(buf) );
-                const double temp = rint(static_cast<double>(i) / x_axis_count_divisor * fit_test_mode_data.fit_test_mode_x_axis_max);
-                static_assert(static_cast<int>(sizeof(buf) - 1) == sizeof(buf) - 1, "Size overflow");
-                checkError3(snprintf(buf, sizeof(buf) - 1, "%u", static_cast<unsigned int>(temp ) ), static_cast<int>(sizeof(buf) - 1), "snprintf error");;
-                draw_horizontal_string(buf, 0.001, axis_x_begin - 0.05 + x_axis_inc * static_cast<double>(i), 0.31);
-                draw_horizontal_string(buf, 0.001, axis_x_begin - 0.05 + x_axis_inc * static_cast<double>(i), 0.31 + axis_y_jump);
-                draw_horizontal_string(buf, 0.001, axis_x_begin - 0.05 + x_axis_inc * static_cast<double>(i), 0.31 + axis_y_jump * 2.0);
+                newest = std::max(newest, segmented_at(series.timestamps, series.timestamps.size - 1) );
             }
+        }
+        return newest;
+    }
 
-            // draw y-axis label
-            draw_vertical_string("Ambient", 0.002, 0.25, 1.5 - 0.2);
-            draw_vertical_string("Mask", 0.002, 0.25, 1.5 + axis_y_jump);
-            draw_vertical_string("Fit factor", 0.002, 0.25, 1.5 + axis_y_jump * 2.0 - 0.5);
-
-            // draw y-axis ticks
-            for(unsigned int i = 0; i <= ambient_y_axis_range; i++)
+    // Publishes the y-axes of the whole history of store, as the window
+    // would show it unzoomed. Releases the snapshot before waiting for the
+    // other instances.
+    template <class Channels>
+    static void headless_sync_store(const SeriesStore<Channels> &store, const unsigned int snapshot_index)
+    {
+        constexpr const size_t channel_count = Channels::CHANNEL_COUNT;
+        double y_axis_min[channel_count], y_axis_max[channel_count];
+        bool default_y_axis[channel_count];
+        for(size_t channel = 0; channel < channel_count; channel++)
+        {
+            const typename SeriesStore<Channels>::Series &series = store.series[channel];
+            double min, max;
+            if(strip_chart_enabled() == true)
             {
-                memset(buf, 0, sizeof(buf) );
-                static_assert(static_cast<int>(sizeof(buf) - 1) == sizeof(buf) - 1, "Size overflow");
-                checkError3(snprintf(buf, sizeof(buf) - 1, "1e%+d", static_cast<int>(ambient_y_axis_min) + static_cast<int>(i) ), static_cast<int>(sizeof(buf) - 1), "snprintf error");;
-                draw_horizontal_string(buf, 0.001, 0.3, ambient_axis_y_begin + ambient_y_axis_inc * static_cast<double>(i) );
+                std::tie(min, max) = strip_min_max(series.strip);
             }
-            for(unsigned int i = 0; i <= sample_y_axis_range; i++)
+            else
             {
-                memset(buf, 0, sizeof(buf) );
-                static_assert(static_cast<int>(sizeof(buf) - 1) == sizeof(buf) - 1, "Size overflow");
-                checkError3(snprintf(buf, sizeof(buf) - 1, "1e%+d", static_cast<int>(sample_y_axis_min) + static_cast<int>(i) ), static_cast<int>(sizeof(buf) - 1), "snprintf error");
-                draw_horizontal_string(buf, 0.001, 0.3, sample_axis_y_begin + sample_y_axis_inc * static_cast<double>(i) );
-            }       
-            for(unsigned int i = 0; i <= fit_factor_y_axis_range; i++)
+                std::tie(min, max) = series_query(series, 0, series_size(series) );
+            }
+            std::tie(y_axis_min[channel], y_axis_max[channel], default_y_axis[channel]) = compute_y_axis(min, max,
+                Channels::descriptors[channel].default_y_axis_min, Channels::descriptors[channel].default_y_axis_max);
+        }
+        snapshot_release(snapshot_index);
+        synchronize_y_axes<Channels>(y_axis_min, y_axis_max, default_y_axis);
+    }
+
+    // the same from the running min and max of each series
+    template <class Channels>
+    static void headless_sync_running(void)
+    {
+        constexpr const size_t channel_count = Channels::CHANNEL_COUNT;
+        const size_t mode_index = static_cast<size_t>(Channels::MODE);
+        double y_axis_min[channel_count], y_axis_max[channel_count];
+        bool default_y_axis[channel_count];
+        {
+            const std::lock_guard<std::mutex> lock_mutex(headless_axes.mutex);
+            for(size_t channel = 0; channel < channel_count; channel++)
             {
-                memset(buf, 0, sizeof(buf) );
-                static_assert(static_cast<int>(sizeof(buf) - 1) == sizeof(buf) - 1, "Size overflow");
-                checkError3(snprintf(buf, sizeof(buf) - 1, "1e%+d", static_cast<int>(fit_factor_y_axis_min) + static_cast<int>(i) ), static_cast<int>(sizeof(buf) - 1), "snprintf error");
-                draw_horizontal_string(buf, 0.001, 0.3, fit_factor_axis_y_begin + fit_factor_y_axis_inc * static_cast<double>(i) );
-            }       
+                std::tie(y_axis_min[channel], y_axis_max[channel], default_y_axis[channel]) = compute_y_axis(headless_axes.min[mode_index][channel],
+                    headless_axes.max[mode_index][channel], Channels::descriptors[channel].default_y_axis_min, Channels::descriptors[channel].default_y_axis_max);
+            }
+        }
+        synchronize_y_axes<Channels>(y_axis_min, y_axis_max, default_y_axis);
+    }
 
-            // draw data points
-            glColor3d(color.R_value, color.G_value, color.B_value);
-            glPointSize(8.0);
-            glBegin(GL_POINTS);
-            const double multiplier = 1.0 / fit_test_mode_data.fit_test_mode_x_axis_max;
-            for(size_t i = 0, size = fit_test_mode_data.ambient_array.size(); i < size; i++)
+    // the instrument is in the mode whose last record is the newest
+    static void headless_sync_y_axes(void)
+    {
+        if(headless_keeps_history() == false)
+        {
+            double fit_test_newest, count_newest;
             {
-                const double x_coord = static_cast<double>(i) * multiplier * 9.0 + axis_x_begin;
-                const double y_coord = (fit_test_mode_data.ambient_array[i] - ambient_y_axis_min) * ambient_y_axis_inc + ambient_axis_y_begin;
-                glVertex3d(x_coord, y_coord, 0.1);
+                const std::lock_guard<std::mutex> lock_mutex(headless_axes.mutex);
+                fit_test_newest = headless_axes.newest[static_cast<size_t>(ModeType::FIT_TEST_MODE)];
+                count_newest = headless_axes.newest[static_cast<size_t>(ModeType::COUNT_MODE)];
             }
-            for(size_t i = 0, size = fit_test_mode_data.sample_array.size(); i < size; i++)
+            if(fit_test_newest > count_newest)
             {
-                const double x_coord = static_cast<double>(i) * multiplier * 9.0 + axis_x_begin;
-                const double y_coord = (fit_test_mode_data.sample_array[i] - sample_y_axis_min) * sample_y_axis_inc + sample_axis_y_begin;
-                glVertex3d(x_coord, y_coord, 0.1);
+                headless_sync_running<FitTestModeChannels>();
             }
-            for(size_t i = 0, size = fit_test_mode_data.fit_factor_array.size(); i < size; i++)
+            else
             {
-                const double x_coord = static_cast<double>(i) * multiplier * 9.0 + axis_x_begin;
-                const double y_coord = (fit_test_mode_data.fit_factor_array[i] - fit_factor_y_axis_min) * fit_factor_y_axis_inc + fit_factor_axis_y_begin;
-                glVertex3d(x_coord, y_coord, 0.1);
+                headless_sync_running<CountModeChannels>();
             }
-            glEnd();
+            return;
+        }
+        const unsigned int index = snapshot_acquire();
+        const DataModel &model = snapshots.models[index];
+        if(series_store_newest(model.fit_test_mode) > series_store_newest(model.count_mode) )
+        {
+            headless_sync_store(model.fit_test_mode, index);
         }
+        else
+        {
+            headless_sync_store(model.count_mode, index);
+        }
+    }
 
-        // swap buffers
-        glutSwapBuffers(); 
+    // --headless: SIGINT, SIGTERM and SIGHUP are blocked in every thread,
+    // from main before the first thread starts, and headless_loop reads them
+    // from a signalfd. No blocking call of any thread is interrupted by them.
+    static sigset_t headless_signals;
+
+    static void headless_block_signals(void)
+    {
+        checkError(sigemptyset(&headless_signals), 0, "sigemptyset error");
+        for(const int signal_number : {SIGINT, SIGTERM, SIGHUP})
+        {
+            checkError(sigaddset(&headless_signals, signal_number), 0, "sigaddset error");
+        }
+        checkError(pthread_sigmask(SIG_BLOCK, &headless_signals, NULL), 0, "pthread_sigmask error");
     }
 
-    static void read_serial_thread(void)
+    // Main thread of a --headless daemon, in place of glutMainLoop: publishes
+    // the y-axes every HEADLESS_SYNC_MS until a signal asks it to quit.
+    static void headless_loop(void)
     {
-        fd_set selector;
-        MutexQueue::StringBuffer input_buf;
-        char stringbuf[128];
+        const int signal_fd = signalfd(-1, &headless_signals, SFD_CLOEXEC);
+        checkError2(signal_fd, -1, "signalfd error");
+
+        const int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        checkError2(timer_fd, -1, "timerfd_create error");
+        struct itimerspec interval;
+        interval.it_interval.tv_sec = HEADLESS_SYNC_MS / 1000;
+        interval.it_interval.tv_nsec = (HEADLESS_SYNC_MS % 1000) * 1000000L;
+        interval.it_value = interval.it_interval;
+        checkError(timerfd_settime(timer_fd, 0, &interval, NULL), 0, "timerfd_settime error");
 
+        pollfd poll_fds[2] = {{.fd = signal_fd, .events = POLLIN, .revents = 0}, {.fd = timer_fd, .events = POLLIN, .revents = 0}};
         for(;;)
         {
-            std::atomic_thread_fence(std::memory_order_seq_cst);
-            if(thread_info.quit.load(std::memory_order_seq_cst) == true)
+            const int ready = poll(poll_fds, 2, -1);
+            if(ready == -1 && errno == EINTR)
             {
+                continue;
+            }
+            checkError2(ready, -1, "poll error");
+            if(poll_fds[0].revents != 0)
+            {
+                signalfd_siginfo info;
+                const ssize_t ret = read(signal_fd, &info, sizeof(info) );
+                checkError(ret, static_cast<ssize_t>(sizeof(info) ), "read error");
+                printf("%s, shutting down\n", strsignal(static_cast<int>(info.ssi_signo) ) );
                 break;
             }
-
-            ssize_t ret;
-            struct timespec time;
-            int str_len;
-
-            FD_ZERO(&selector);
-            FD_SET(fds.serial_fd, &selector);
-
-            timeval timeout = {0, 100000};
-            checkError2(select(fds.serial_fd + 1, &selector, NULL, NULL, &timeout), -1, "select error");
-            if(FD_ISSET(fds.serial_fd, &selector) )
+            if(poll_fds[1].revents != 0)
             {
-                memset(input_buf.buf, 0, sizeof(input_buf.buf));
-                ret = read(fds.serial_fd, input_buf.buf, sizeof(input_buf.buf) - 1);
-                checkError2(ret, -1L, "read error");
-                if(ret > 0)
-                {
-                    checkError(clock_gettime(CLOCK_MONOTONIC, &time), 0, "clock_gettime error");
-                    double timeval = static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) * 0.000000001;
-                    memset(stringbuf, 0, sizeof(stringbuf));
-                    str_len = snprintf(stringbuf, sizeof(stringbuf) - 1, "%20.9f: ", timeval);
-                    static_assert(static_cast<int>(sizeof(stringbuf) - 1) == sizeof(stringbuf) - 1, "Size overflow"); 
-                    checkError3(str_len, static_cast<int>(sizeof(stringbuf) - 1), "snprintf error");
-                    printf("%s", input_buf.buf);
-                    writeFully(fds.outfile_fd, stringbuf, static_cast<size_t>(str_len) );
-                    writeFully(fds.outfile_fd, input_buf.buf, static_cast<size_t>(ret) );
-                    input_buf.size = static_cast<size_t>(ret);
-                    {
-                        const std::lock_guard<std::mutex> lock_mutex(mutex_string_queue.queue_mutex);
-                        std::atomic_thread_fence(std::memory_order_seq_cst);
-                        mutex_string_queue.string_queue.push(input_buf);
-                        std::atomic_thread_fence(std::memory_order_seq_cst);
-                    }
-                }
+                uint64_t expirations;
+                const ssize_t ret = read(timer_fd, &expirations, sizeof(expirations) );
+                checkError(ret, static_cast<ssize_t>(sizeof(expirations) ), "read error");
+                headless_sync_y_axes();
             }
         }
+        // the signals stay blocked, a second one during shutdown stays pending
+        checkError(close(timer_fd), 0, "close error");
+        checkError(close(signal_fd), 0, "close error");
     }
 
-    static void timer_func(const int value)
+    // the arrival time as the output file stores it, rounded to ns
+    static inline double logged_timestamp(const double timestamp)
     {
-        (void)value;
+        char buf[64];
+        checkError3(snprintf(buf, sizeof(buf), "%.9f", timestamp), static_cast<int>(sizeof(buf) ), "snprintf error");
+        return strtod(buf, NULL);
+    }
 
-        MutexQueue::StringBuffer input_buf;
-        bool has_input = false;
+    // Where a replayed output file ends: the logged arrival time of its last
+    // record and how many records have that time. Records of one read share
+    // their arrival time, and a group commit can split them.
+    struct ReplayEnd
+    {
+        double timestamp;
+        size_t records_at_timestamp;
+    };
 
+    // Replays the output file of the daemon an --attach viewer shows into
+    // both snapshot copies, before the ingest thread starts. The live feed
+    // continues after the end it returns.
+    static ReplayEnd replay_output_file(const char *const path)
+    {
+        const double start = monotonic_seconds();
+        FILE *const file = fopen(path, "r");
+        checkError2(file, static_cast<FILE *>(NULL), "fopen error");
+        checkError(setvbuf(file, NULL, _IOFBF, 1 << 20), 0, "setvbuf error");
+        char *line = NULL;
+        size_t capacity = 0;
+        size_t records = 0;
+        ReplayEnd replay_end = {.timestamp = 0.0, .records_at_timestamp = 0};
+        while(getline(&line, &capacity, file) > 0)
         {
-            const std::lock_guard<std::mutex> lock_mutex(mutex_string_queue.queue_mutex);
-            std::atomic_thread_fence(std::memory_order_seq_cst);
-            if(mutex_string_queue.string_queue.empty() == false)
+            char *end;
+            const double timestamp = strtod(line, &end);
+            if(end == line || end[0] != ':' || end[1] != ' ')
             {
-                input_buf = mutex_string_queue.string_queue.front();
-                mutex_string_queue.string_queue.pop();
-                has_input = true;
+                continue;
             }
-            std::atomic_thread_fence(std::memory_order_seq_cst);
+            ModelOp op;
+            op.reset = false;
+            if(parse_live_record<CountModeChannels>(end + 2, timestamp, op.record) == false &&
+                parse_live_record<FitTestModeChannels>(end + 2, timestamp, op.record) == false)
+            {
+                continue;
+            }
+            for(DataModel &model : snapshots.models)
+            {
+                model_apply(model, op);
+            }
+            replay_end.records_at_timestamp = (timestamp == replay_end.timestamp) ? (replay_end.records_at_timestamp + 1) : 1;
+            replay_end.timestamp = timestamp;
+            records++;
         }
+        checkError(ferror(file), 0, "getline error");
+        free(line);
+        checkError(fclose(file), 0, "fclose error");
+        printf("replayed %zu records from %s in %.1f ms\n", records, path, (monotonic_seconds() - start) * 1000.0);
+        return replay_end;
+    }
 
-        if(has_input == true)
+    // Serial thread of an --attach viewer: queues the records of the daemon's
+    // live feed after the end of the replayed output file, which lags the
+    // feed by up to a group commit. The feed's times are compared as the file
+    // logs them, and of the records at the file's last time as many are
+    // skipped as the file has.
+    static void attach_thread(const ReplayEnd replayed)
+    {
+        LiveFeedCursor cursor;
+        LiveRecord record;
+        size_t skip = replayed.records_at_timestamp;
+        bool oldest = true;
+        live_feed_seek_oldest(attached_feed, &cursor);
+        while(thread_info.quit.load(std::memory_order_seq_cst) == false)
         {
-            double val;
-            if(mode == ModeType::COUNT_MODE)
-            {
-                if(sscanf(input_buf.buf, "Conc. %lf #/cc", &val) == 1)
-                {
-                    if(val == 0.0)
-                    {
-                        // change 0.0 to 0.001 to avoid log(0)
-                        val = 0.001;
-                    }
-                    val = log10(val);
-                    count_mode_data.count_array.push_back(val);
-                    if(static_cast<double>(count_mode_data.count_array.size() ) > count_mode_data.count_mode_x_axis_max)
-                    {
-                        count_mode_data.count_mode_x_axis_max *= 2.0;
-                    }
-                    if(val < count_mode_data.count_array_min)
-                    {
-                        count_mode_data.count_array_min = val;
-                    }
-                    if(val > count_mode_data.count_array_max)
-                    {
-                        count_mode_data.count_array_max = val;
-                    }
-                }
-            }
-            else if(mode == ModeType::FIT_TEST_MODE)
+            if(live_feed_read(attached_feed, &cursor, &record) == false)
             {
-                if(sscanf(input_buf.buf, "Mask %lf #/cc", &val) == 1)
-                {
-                    val = log10(val);
-                    fit_test_mode_data.sample_array.push_back(val);
-                    if(static_cast<double>(fit_test_mode_data.sample_array.size() ) > fit_test_mode_data.fit_test_mode_x_axis_max)
-                    {
-                        fit_test_mode_data.fit_test_mode_x_axis_max *= 2.0;
-                    }
-                    if(val < fit_test_mode_data.sample_array_min)
-                    {
-                        fit_test_mode_data.sample_array_min = val;
-                    }
-                    if(val > fit_test_mode_data.sample_array_max)
-                    {
-                        fit_test_mode_data.sample_array_max = val;
-                    }
-                }
-                else if(sscanf(input_buf.buf, "Ambient %lf #/cc", &val) == 1)
-                {
-                    val = log10(val);
-                    fit_test_mode_data.ambient_array.push_back(val);
-                    if(static_cast<double>(fit_test_mode_data.ambient_array.size() ) > fit_test_mode_data.fit_test_mode_x_axis_max)
-                    {
-                        fit_test_mode_data.fit_test_mode_x_axis_max *= 2.0;
-                    }
-                    if(val < fit_test_mode_data.ambient_array_min)
-                    {
-                        fit_test_mode_data.ambient_array_min = val;
-                    }
-                    if(val > fit_test_mode_data.ambient_array_max)
-                    {
-                        fit_test_mode_data.ambient_array_max = val;
-                    }
-                }
-                else if(sscanf(input_buf.buf, "FF %*u %lf PASS", &val) == 1 || sscanf(input_buf.buf, "FF %*u %lf FAIL", &val) == 1)
-                {
-                    val = log10(val);
-                    fit_test_mode_data.fit_factor_array.push_back(val);
-                    if(static_cast<double>(fit_test_mode_data.fit_factor_array.size() ) > fit_test_mode_data.fit_test_mode_x_axis_max)
-                    {
-                        fit_test_mode_data.fit_test_mode_x_axis_max *= 2.0;
-                    }
-                    if(val < fit_test_mode_data.fit_factor_array_min)
-                    {
-                        fit_test_mode_data.fit_factor_array_min = val;
-                    }
-                    if(val > fit_test_mode_data.fit_factor_array_max)
-                    {
-                        fit_test_mode_data.fit_factor_array_max = val;
-                    }
+                if(cursor.closed == true)
+                {
+                    printf("attach: the daemon has exited, the window keeps its records\n");
+                    break;
                 }
+                sleepMicroseconds(ATTACH_POLL_MS * 1000);
+                continue;
+            }
+            const double timestamp = logged_timestamp(record.timestamp);
+            if(oldest == true && record.sequence > 0 && timestamp > replayed.timestamp)
+            {
+                printf("attach: the live feed of the daemon starts after the end of its output file, the records between them are missing\n");
+            }
+            oldest = false;
+            if(timestamp < replayed.timestamp)
+            {
+                continue;
             }
-            // signal redraw
+            if(timestamp == replayed.timestamp && skip > 0)
+            {
+                skip--;
+                continue;
+            }
+            ingest_queue_push(record);
+        }
+        if(cursor.lost > 0)
+        {
+            printf("attach: %llu records of the daemon lost, the viewer fell behind its live feed\n", static_cast<unsigned long long int>(cursor.lost) );
+        }
+    }
+
+#ifndef GRAPH_HEADLESS
+    static void timer_func(const int value)
+    {
+        (void)value;
+
+        // redraw when the geometry thread published a new frame, and keep
+        // the overload indicator current
+        const IngestStatus status = current_ingest_status();
+        if(geometry.published_sequence.load(std::memory_order_acquire) != drawn_sequence ||
+            status.behind > 0.0 || drawn_status.behind > 0.0 ||
+            status.dropped != drawn_status.dropped || status.coalesced != drawn_status.coalesced ||
+            active_alarms() != drawn_alarms)
+        {
             glutPostRedisplay();
         }
-        
-        glutTimerFunc(100, timer_func, 0);
+
+        glutTimerFunc(REDRAW_POLL_MS, timer_func, 0);
     }
 
     static void init_graphics(void)
@@ -867,19 +5253,35 @@ namespace
         glHint(GL_POINT_SMOOTH_HINT, GL_NICEST);
         glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 
-        GLint actual_sample_count = 0;
-        glGetIntegerv(GL_SAMPLES, &actual_sample_count);
-        if(actual_sample_count != SAMPLE_COUNT)
+        if(render_governor_enabled() == true)
+        {
+            init_render_governor();
+        }
+        else if(panel_cache_wanted() == true)
         {
-            printf("actual sample count = %d, requested sample count = %d\n", actual_sample_count, SAMPLE_COUNT);
+            init_panel_cache();
+        }
+        else
+        {
+            const int requested_sample_count = std::min(SAMPLE_COUNT, options.max_samples);
+            GLint actual_sample_count = 0;
+            glGetIntegerv(GL_SAMPLES, &actual_sample_count);
+            if(actual_sample_count != requested_sample_count)
+            {
+                printf("actual sample count = %d, requested sample count = %d\n", actual_sample_count, requested_sample_count);
+            }
         }
 
         // callbacks
         glutDisplayFunc(display);
         glutReshapeFunc(reshape);
         glutKeyboardFunc(keyboard_func);
-        glutTimerFunc(100, timer_func, 0);
+        glutSpecialFunc(special_func);
+        glutMouseFunc(mouse_func);
+        glutMotionFunc(motion_func);
+        glutTimerFunc(REDRAW_POLL_MS, timer_func, 0);
     }
+#endif
 
     static inline int open_shared_memory_object(const char *const name, const off_t length, const int oflag)
     {
@@ -911,7 +5313,7 @@ namespace
             {
                 break;
             }
-            checkError(usleep(100000), 0, "usleep error");
+            sleepMicroseconds(100000);
         }
         checkError2(fd, -1, "shm_open error");
         const uid_t current_euid = geteuid();
@@ -953,7 +5355,8 @@ namespace
             checkError3(snprintf(name_buf_sem, sizeof(name_buf_sem) - 1, "%s_semaphore_%u", shared_memory_prefix, i), static_cast<int>(sizeof(name_buf_sem) - 1), "snprintf error");
             checkError3(snprintf(name_buf_data, sizeof(name_buf_data) - 1, "%s_data_%u", shared_memory_prefix, i), static_cast<int>(sizeof(name_buf_data) - 1), "snprintf error");
             sem_fd = open_shared_memory_object(name_buf_sem, sizeof(sem_t), O_RDWR);
-            data_fd = open_shared_memory_object(name_buf_data, sizeof(SharedMemoryBuffer), ((instance.instance_index == i) ? (O_RDWR) : (O_RDONLY) ) );
+            const bool own = (instance.instance_index == i && options.attach == false);
+            data_fd = open_shared_memory_object(name_buf_data, sizeof(SharedMemoryBuffer), (own ? (O_RDWR) : (O_RDONLY) ) );
             reserve_ptr = mmap(NULL, page_size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
             checkError2(reserve_ptr, MAP_FAILED, "mmap error");
             sem_ptr = mmap(reserve_ptr, sizeof(sem_t), PROT_WRITE | PROT_READ, MAP_SHARED | MAP_FIXED, sem_fd, 0);
@@ -961,7 +5364,7 @@ namespace
             semaphore_ptrs[i] = static_cast<sem_t *>(sem_ptr);
             reserve_ptr = mmap(NULL, page_size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
             checkError2(reserve_ptr, MAP_FAILED, "mmap error");
-            data_ptr = mmap(reserve_ptr, sizeof(SharedMemoryBuffer), ((instance.instance_index == i) ? (PROT_WRITE | PROT_READ) : (PROT_READ) ), MAP_SHARED | MAP_FIXED, data_fd, 0);
+            data_ptr = mmap(reserve_ptr, sizeof(SharedMemoryBuffer), (own ? (PROT_WRITE | PROT_READ) : (PROT_READ) ), MAP_SHARED | MAP_FIXED, data_fd, 0);
             checkError2(data_ptr, MAP_FAILED, "mmap error");
             shared_memory_ptrs[i] = static_cast<SharedMemoryBuffer *>(data_ptr);
             checkError(flock(sem_fd, LOCK_UN), 0, "flock error");
@@ -970,10 +5373,14 @@ namespace
             checkError(close(data_fd), 0, "close error");
         }
 
-        checkError(sem_init(semaphore_ptrs[instance.instance_index], 1, 1), 0, "sem_init error");
-        memset(shared_memory_ptrs[instance.instance_index], 0, sizeof(SharedMemoryBuffer) );
-        atomic_test_and_set(shared_memory_ptrs[instance.instance_index]->initialized, false, true);
-        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // the slot of an attached viewer's instance belongs to the daemon
+        if(options.attach == false)
+        {
+            checkError(sem_init(semaphore_ptrs[instance.instance_index], 1, 1), 0, "sem_init error");
+            memset(shared_memory_ptrs[instance.instance_index], 0, sizeof(SharedMemoryBuffer) );
+            atomic_test_and_set(shared_memory_ptrs[instance.instance_index]->initialized, false, true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
 
         for(unsigned int i = 0; i < instance.total_instances; i++)
         {
@@ -988,8 +5395,192 @@ namespace
                 {
                     break;
                 }
-                checkError(usleep(100000), 0, "usleep error");
+                sleepMicroseconds(100000);
+            }
+        }
+    }
+
+    static void init_live_feed(void)
+    {
+        char name_buf[250];
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+        static_assert(static_cast<int>(sizeof(name_buf) - 1) == sizeof(name_buf) - 1, "Size overflow");
+        checkError3(live_feed_name(name_buf, sizeof(name_buf) - 1, instance.instance_index), static_cast<int>(sizeof(name_buf) - 1), "snprintf error");
+        const int fd = open_shared_memory_object(name_buf, static_cast<off_t>(live_feed_size() ), O_RDWR);
+        void *const ptr = mmap(NULL, live_feed_size(), PROT_WRITE | PROT_READ, MAP_SHARED, fd, 0);
+        checkError2(ptr, MAP_FAILED, "mmap error");
+        assertWithMsg(reinterpret_cast<uintptr_t>(ptr) % page_size == 0, "Unexpected mmap alignment");
+        checkError(flock(fd, LOCK_UN), 0, "flock error");
+        checkError(close(fd), 0, "close error");
+        memset(ptr, 0, live_feed_size() );
+        live_feed = static_cast<LiveFeedHeader *>(ptr);
+        live_feed_init(live_feed);
+    }
+
+    static inline size_t fleet_log_size(void)
+    {
+        return sizeof(FleetLogHeader) + sizeof(FleetLogSlot) * FLEET_LOG_CAPACITY;
+    }
+
+    // maps the fleet log shared by all instances, creating it if this is the first
+    static void init_fleet_log(void)
+    {
+        char name_buf[250];
+
+        static_assert(static_cast<int>(sizeof(name_buf) - 1) == sizeof(name_buf) - 1, "Size overflow");
+        checkError3(snprintf(name_buf, sizeof(name_buf) - 1, "%s_fleet", shared_memory_prefix), static_cast<int>(sizeof(name_buf) - 1), "snprintf error");
+        const int fd = open_shared_memory_object(name_buf, static_cast<off_t>(fleet_log_size() ), O_RDWR);
+        void *const ptr = mmap(NULL, fleet_log_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        checkError2(ptr, MAP_FAILED, "mmap error");
+        checkError(flock(fd, LOCK_UN), 0, "flock error");
+        checkError(close(fd), 0, "close error");
+        fleet_log.header = static_cast<FleetLogHeader *>(ptr);
+        fleet_log.slots = reinterpret_cast<FleetLogSlot *>(fleet_log.header + 1);
+        fleet_log.quit.store(false);
+
+        if(options.fleet_record_path == NULL)
+        {
+            if(fleet_log.header->drainer.load(std::memory_order_acquire) == 0)
+            {
+                fprintf(stderr, "warning: no instance with --fleet-record drains the fleet log, lines beyond %llu will be dropped\n",
+                    static_cast<unsigned long long int>(FLEET_LOG_CAPACITY) );
+            }
+            return;
+        }
+
+        // a second drainer would free slots out of lap order
+        const int32_t pid = static_cast<int32_t>(getpid() );
+        int32_t drainer = 0;
+        while(fleet_log.header->drainer.compare_exchange_strong(drainer, pid, std::memory_order_acq_rel) == false)
+        {
+            if(kill(drainer, 0) == 0 || errno != ESRCH)
+            {
+                fprintf(stderr, "The fleet log is already drained by process %d\n", static_cast<int>(drainer) );
+                exit(1);
+            }
+            // left behind by a drainer that crashed, the ring continues at its tail
+        }
+        const int flags = (options.append_output == true) ? (O_WRONLY | O_APPEND | O_CREAT) : (O_WRONLY | O_CREAT | O_EXCL);
+        fleet_log.record_fd = open(options.fleet_record_path, flags | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        checkError2(fleet_log.record_fd, -1, "open error");
+    }
+
+    // drainer: copies out the next line and frees its slot, false if there is none yet
+    static bool fleet_log_read(FleetLine &line)
+    {
+        const uint64_t position = fleet_log.header->tail.load(std::memory_order_relaxed);
+        FleetLogSlot &slot = fleet_log.slots[position & (FLEET_LOG_CAPACITY - 1)];
+        const uint64_t lap_state = position / FLEET_LOG_CAPACITY * 2;
+        if(slot.state.load(std::memory_order_acquire) != lap_state + 1)
+        {
+            return false;
+        }
+        line.timestamp = slot.line.timestamp;
+        line.source = slot.line.source;
+        line.length = slot.line.length;
+        memcpy(line.text, slot.line.text, slot.line.length);
+        slot.state.store(lap_state + 2, std::memory_order_release);
+        fleet_log.header->tail.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // orders the heap of waiting lines by arrival, then instance
+    static bool fleet_line_later(const FleetLine &a, const FleetLine &b)
+    {
+        return (a.timestamp != b.timestamp) ? (a.timestamp > b.timestamp) : (a.source > b.source);
+    }
+
+    // Drains the fleet log into the recording, each line prefixed with its
+    // arrival time and instance index. Lines are held back for
+    // FLEET_REORDER_SECONDS and written in arrival order; the writes are
+    // covered by one fdatasync every sync_interval_ms.
+    static void fleet_thread(void)
+    {
+        std::vector<FleetLine> waiting;
+        std::vector<char> batch;
+        FleetLine line;
+        char prefix[64];
+        double last_sync = monotonic_seconds();
+
+        for(;;)
+        {
+            const bool quit = fleet_log.quit.load();
+            while(fleet_log_read(line) == true)
+            {
+                waiting.push_back(line);
+                std::push_heap(waiting.begin(), waiting.end(), fleet_line_later);
+            }
+            const double now = monotonic_seconds();
+            while(waiting.empty() == false && (quit == true || waiting.front().timestamp <= now - FLEET_REORDER_SECONDS) )
+            {
+                std::pop_heap(waiting.begin(), waiting.end(), fleet_line_later);
+                const FleetLine &next = waiting.back();
+                const int prefix_length = snprintf(prefix, sizeof(prefix) - 1, "%20.9f %u: ", next.timestamp, next.source);
+                static_assert(static_cast<int>(sizeof(prefix) - 1) == sizeof(prefix) - 1, "Size overflow");
+                checkError3(prefix_length, static_cast<int>(sizeof(prefix) - 1), "snprintf error");
+                batch.insert(batch.end(), prefix, prefix + prefix_length);
+                batch.insert(batch.end(), next.text, next.text + next.length);
+                waiting.pop_back();
+            }
+            if(batch.empty() == false && (quit == true || now - last_sync >= static_cast<double>(options.sync_interval_ms) / 1000.0) )
+            {
+                writeFully(fleet_log.record_fd, batch.data(), batch.size() );
+                checkError(fdatasync(fleet_log.record_fd), 0, "fdatasync error");
+                batch.clear();
+                last_sync = now;
+            }
+            if(quit == true)
+            {
+                break;
             }
+            sleepMicroseconds(FLEET_POLL_MS * 1000);
+        }
+    }
+
+    // After remove_shared_memory, when every instance has stopped appending:
+    // the drainer writes what is left, then the log is unmapped and removed.
+    static void fleet_log_close(std::thread &thread)
+    {
+        char name_buf[250];
+
+        if(thread.joinable() == true)
+        {
+            fleet_log.quit.store(true);
+            thread.join();
+            checkError(close(fleet_log.record_fd), 0, "close error");
+            fleet_log.header->drainer.store(0, std::memory_order_release);
+        }
+        const unsigned long long dropped = fleet_log.header->dropped.load();
+        if(dropped > 0)
+        {
+            printf("fleet log full: %llu lines dropped\n", dropped);
+        }
+        checkError(munmap(fleet_log.header, fleet_log_size() ), 0, "munmap error");
+        fleet_log.header = NULL;
+        fleet_log.slots = NULL;
+        static_assert(static_cast<int>(sizeof(name_buf) - 1) == sizeof(name_buf) - 1, "Size overflow");
+        checkError3(snprintf(name_buf, sizeof(name_buf) - 1, "%s_fleet", shared_memory_prefix), static_cast<int>(sizeof(name_buf) - 1), "snprintf error");
+        const int ret = shm_unlink(name_buf);
+        if(ret != 0 && errno != ENOENT)
+        {
+            checkError(ret, 0, "shm_unlink error");
+        }
+    }
+
+    static void remove_live_feed(void)
+    {
+        char name_buf[250];
+
+        live_feed_close(live_feed);
+        checkError(munmap(live_feed, live_feed_size() ), 0, "munmap error");
+        live_feed = NULL;
+        static_assert(static_cast<int>(sizeof(name_buf) - 1) == sizeof(name_buf) - 1, "Size overflow");
+        checkError3(live_feed_name(name_buf, sizeof(name_buf) - 1, instance.instance_index), static_cast<int>(sizeof(name_buf) - 1), "snprintf error");
+        const int ret = shm_unlink(name_buf);
+        if(ret != 0 && errno != ENOENT)
+        {
+            checkError(ret, 0, "shm_unlink error");
         }
     }
 
@@ -1000,10 +5591,13 @@ namespace
         const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
 
         shared_memory_ptrs[instance.instance_index]->valid = false;
-        shared_memory_ptrs[instance.instance_index]->count_mode.y_axis_valid = false;
-        shared_memory_ptrs[instance.instance_index]->fit_test_mode.ambient_y_axis_valid = false;
-        shared_memory_ptrs[instance.instance_index]->fit_test_mode.sample_y_axis_valid = false;
-        shared_memory_ptrs[instance.instance_index]->fit_test_mode.fit_factor_y_axis_valid = false;
+        for(size_t i = 0; i < MODE_COUNT; i++)
+        {
+            for(size_t j = 0; j < MAX_CHANNEL_COUNT; j++)
+            {
+                shared_memory_ptrs[instance.instance_index]->axes[i][j].y_axis_valid = false;
+            }
+        }
         atomic_test_and_set(shared_memory_ptrs[instance.instance_index]->quit, false, true);
         std::atomic_thread_fence(std::memory_order_seq_cst);
 
@@ -1020,7 +5614,7 @@ namespace
                 {
                     break;
                 }
-                checkError(usleep(100000), 0, "usleep error");
+                sleepMicroseconds(100000);
             }
         }
 
@@ -1055,8 +5649,229 @@ namespace
         delete [] semaphore_ptrs;
         semaphore_ptrs = NULL;
     }
+
+    // returns the text after "name=" if arg is that option, NULL otherwise
+    static inline const char *option_value(const char *const arg, const char *const name)
+    {
+        const size_t name_length = strlen(name);
+        if(strncmp(arg, name, name_length) == 0 && arg[name_length] == '=')
+        {
+            return arg + name_length + 1;
+        }
+        return NULL;
+    }
+
+    static inline long int parse_long_option(const char *const value, const long int min, const long int max, const char *const msg)
+    {
+        char *end = NULL;
+        errno = 0;
+        const long int temp_long = strtol(value, &end, 10);
+        assertWithMsg(errno == 0 && end != value && *end == '\0' && temp_long >= min && temp_long <= max, msg);
+        return temp_long;
+    }
+
+    static inline double parse_double_option(const char *const value, const double min, const double max, const char *const msg)
+    {
+        char *end = NULL;
+        errno = 0;
+        const double temp_dbl = strtod(value, &end);
+        assertWithMsg(errno == 0 && end != value && *end == '\0' && temp_dbl >= min && temp_dbl <= max, msg);
+        return temp_dbl;
+    }
+
+    // options start with "--", anything else is left for glutInit
+    static void parse_options(const int argc, char *const argv[], const int first)
+    {
+        for(int i = first; i < argc; i++)
+        {
+            const char *value;
+            if(strncmp(argv[i], "--", 2) != 0)
+            {
+                continue;
+            }
+            else if(strcmp(argv[i], "--append") == 0)
+            {
+                options.append_output = true;
+            }
+            else if( (value = option_value(argv[i], "--sync-interval-ms") ) != NULL)
+            {
+                options.sync_interval_ms = static_cast<unsigned long>(parse_long_option(value, 1, 60000, "sync-interval-ms out of range") );
+            }
+            else if( (value = option_value(argv[i], "--sync-bytes") ) != NULL)
+            {
+                options.sync_bytes = static_cast<size_t>(parse_long_option(value, 1, 64L * 1024 * 1024, "sync-bytes out of range") );
+            }
+            else if( (value = option_value(argv[i], "--preallocate-bytes") ) != NULL)
+            {
+                options.preallocate_bytes = static_cast<size_t>(parse_long_option(value, 0, 1024L * 1024 * 1024, "preallocate-bytes out of range") );
+            }
+            else if( (value = option_value(argv[i], "--stream-socket") ) != NULL)
+            {
+                assertWithMsg(value[0] != '\0' && strlen(value) < sizeof(sockaddr_un::sun_path), "stream-socket path too long");
+                options.stream_socket_path = value;
+            }
+            else if( (value = option_value(argv[i], "--stream-port") ) != NULL)
+            {
+                options.stream_port = static_cast<unsigned int>(parse_long_option(value, 1, 65535, "stream-port out of range") );
+            }
+            else if( (value = option_value(argv[i], "--stream-queue") ) != NULL)
+            {
+                options.stream_queue_frames = static_cast<size_t>(parse_long_option(value, 2, 1024L * 1024, "stream-queue out of range") );
+            }
+            else if(strcmp(argv[i], "--realtime") == 0)
+            {
+                options.realtime = true;
+            }
+            else if( (value = option_value(argv[i], "--realtime-priority") ) != NULL)
+            {
+                options.realtime_priority = static_cast<int>(parse_long_option(value, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO), "realtime-priority out of range") );
+            }
+            else if( (value = option_value(argv[i], "--realtime-cpu") ) != NULL)
+            {
+                options.realtime_cpu = static_cast<int>(parse_long_option(value, 0, CPU_SETSIZE - 1, "realtime-cpu out of range") );
+            }
+            else if(strcmp(argv[i], "--jitter-report") == 0)
+            {
+                options.jitter_report = true;
+            }
+            else if(strcmp(argv[i], "--rollups") == 0)
+            {
+                options.rollups = true;
+            }
+            else if(strcmp(argv[i], "--fleet") == 0)
+            {
+                options.fleet = true;
+            }
+            else if( (value = option_value(argv[i], "--fleet-record") ) != NULL)
+            {
+                assertWithMsg(value[0] != '\0', "fleet-record path empty");
+                options.fleet = true;
+                options.fleet_record_path = value;
+            }
+            else if( (value = option_value(argv[i], "--strip-chart-seconds") ) != NULL)
+            {
+                options.strip_chart_seconds = parse_double_option(value, 1.0, 7.0 * 24.0 * 3600.0, "strip-chart-seconds out of range");
+            }
+            else if( (value = option_value(argv[i], "--strip-chart-samples") ) != NULL)
+            {
+                options.strip_chart_samples = static_cast<size_t>(parse_long_option(value, 2, 64L * 1024 * 1024, "strip-chart-samples out of range") );
+            }
+            else if(strcmp(argv[i], "--compact-history") == 0)
+            {
+                options.compact_history = true;
+            }
+            else if(strcmp(argv[i], "--headless") == 0)
+            {
+                options.headless = true;
+            }
+            else if(strcmp(argv[i], "--attach") == 0)
+            {
+                options.attach = true;
+            }
+            else if( (value = option_value(argv[i], "--frame-budget-ms") ) != NULL)
+            {
+                options.frame_budget_ms = parse_double_option(value, 1.0, 10000.0, "frame-budget-ms out of range");
+            }
+            else if( (value = option_value(argv[i], "--max-samples") ) != NULL)
+            {
+                options.max_samples = static_cast<int>(parse_long_option(value, 0, SAMPLE_COUNT, "max-samples out of range") );
+            }
+            else if(strcmp(argv[i], "--full-redraw") == 0)
+            {
+                options.full_redraw = true;
+            }
+            else if( (value = option_value(argv[i], "--checkpoint") ) != NULL)
+            {
+                assertWithMsg(value[0] != '\0' && strlen(value) < 4000, "checkpoint path empty or too long");
+                options.checkpoint_path = value;
+            }
+            else if( (value = option_value(argv[i], "--checkpoint-interval-ms") ) != NULL)
+            {
+                options.checkpoint_interval_ms = static_cast<unsigned long>(parse_long_option(value, 100, 3600000, "checkpoint-interval-ms out of range") );
+            }
+            else if( (value = option_value(argv[i], "--alarm-ambient-min") ) != NULL)
+            {
+                options.alarm_ambient_min = parse_double_option(value, 0.0, 1e9, "alarm-ambient-min out of range");
+            }
+            else if( (value = option_value(argv[i], "--alarm-fit-factor-min") ) != NULL)
+            {
+                options.alarm_fit_factor_min = parse_double_option(value, 0.0, 1e9, "alarm-fit-factor-min out of range");
+            }
+            else if( (value = option_value(argv[i], "--alarm-hook") ) != NULL)
+            {
+                assertWithMsg(value[0] != '\0', "alarm-hook is empty");
+                options.alarm_hook = value;
+            }
+            else if( (value = option_value(argv[i], "--alarm-deadline-ms") ) != NULL)
+            {
+                options.alarm_deadline_ms = static_cast<unsigned long>(parse_long_option(value, 1, 60000, "alarm-deadline-ms out of range") );
+            }
+            else if( (value = option_value(argv[i], "--alarm-hook-timeout-ms") ) != NULL)
+            {
+                options.alarm_hook_timeout_ms = static_cast<unsigned long>(parse_long_option(value, 1, 3600000, "alarm-hook-timeout-ms out of range") );
+            }
+            else if( (value = option_value(argv[i], "--ingest-queue") ) != NULL)
+            {
+                options.ingest_queue_records = static_cast<size_t>(parse_long_option(value, 1, 1024L * 1024, "ingest-queue out of range") );
+            }
+            else if( (value = option_value(argv[i], "--ingest-policy") ) != NULL)
+            {
+                if(strcmp(value, "block") == 0)
+                {
+                    options.ingest_policy = IngestPolicy::BLOCK;
+                }
+                else if(strcmp(value, "drop-oldest") == 0)
+                {
+                    options.ingest_policy = IngestPolicy::DROP_OLDEST;
+                }
+                else if(strcmp(value, "coalesce") == 0)
+                {
+                    options.ingest_policy = IngestPolicy::COALESCE;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid ingest-policy\n");
+                    exit(1);
+                }
+            }
+            else if( (value = option_value(argv[i], "--stream-policy") ) != NULL)
+            {
+                if(strcmp(value, "drop-oldest") == 0)
+                {
+                    options.stream_policy = SlowClientPolicy::DROP_OLDEST;
+                }
+                else if(strcmp(value, "disconnect") == 0)
+                {
+                    options.stream_policy = SlowClientPolicy::DISCONNECT;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid stream-policy\n");
+                    exit(1);
+                }
+            }
+            else
+            {
+                fprintf(stderr, "Unknown option %s\n", argv[i]);
+                exit(1);
+            }
+        }
+        assertWithMsg(options.strip_chart_seconds == 0.0 || options.strip_chart_samples == 0, "strip-chart-seconds and strip-chart-samples are exclusive");
+        // a strip chart keeps no history to checkpoint
+        assertWithMsg(strip_chart_enabled() == false || options.checkpoint_path == NULL, "checkpoint does not work with a strip chart");
+        assertWithMsg(options.headless == false || options.frame_budget_ms == 0.0, "frame-budget-ms needs a window, not --headless");
+#ifdef GRAPH_HEADLESS
+        assertWithMsg(options.attach == false, "--attach needs a window, graph_headless is built without one");
+#endif
+        // a viewer neither reads the instrument nor writes or serves anything, the daemon does
+        assertWithMsg(options.attach == false || (options.headless == false && options.append_output == false && options.rollups == false &&
+            options.fleet == false && options.checkpoint_path == NULL && stream_server_enabled() == false && alarm_enabled() == false &&
+            options.realtime == false && options.jitter_report == false), "--attach cannot be combined with options of the daemon");
+    }
 }
 
+// bench.cpp includes this file for the internals and brings its own main
+#ifndef GRAPH_NO_MAIN
 int main(int argc, char *argv[])
 {
     termios config, config2;
@@ -1064,12 +5879,18 @@ int main(int argc, char *argv[])
     double temp_dbl;
     long int temp_long;
 
-    assertWithMsg(argc >= 11, "Need more arguments: <device> <baud rate> <output_file> <window_x> <window_y> <R_value> <G_value> <B_value> <total_instances> <instance_index>");
+    assertWithMsg(argc >= 11, "Need more arguments: <device> <baud rate> <output_file> <window_x> <window_y> <R_value> <G_value> <B_value> <total_instances> <instance_index> [options]");
+    parse_options(argc, argv, 11);
+    if(options.headless == true)
+    {
+        headless_block_signals();
+    }
 
-    count_mode_data.count_array.reserve(20);
-    fit_test_mode_data.ambient_array.reserve(20);
-    fit_test_mode_data.sample_array.reserve(20);
-    fit_test_mode_data.fit_factor_array.reserve(20);
+    snapshots_init();
+    headless_axes_init();
+    ingest_queue.quit = false;
+    ingest_queue.dropped.store(0);
+    ingest_queue.coalesced.store(0);
 
     temp_long = strtol(argv[4], NULL, 10);
     assertWithMsg(temp_long >= 0 && temp_long <= 5000, "window_x out of range");
@@ -1126,61 +5947,215 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    fds.serial_fd = open(argv[1], O_RDONLY | O_CLOEXEC | O_NOCTTY);
-    checkError2(fds.serial_fd, -1, "open error");
+    // an attached viewer shows the records of a running daemon, which owns
+    // the serial port, the output file and everything written next to it
+    ReplayEnd replayed = {.timestamp = 0.0, .records_at_timestamp = 0};
+    if(options.attach == false)
+    {
+        fds.serial_fd = open(argv[1], O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        checkError2(fds.serial_fd, -1, "open error");
 
-    checkError(isatty(fds.serial_fd), 1, "isatty error");
+        checkError(isatty(fds.serial_fd), 1, "isatty error");
 
-    fds.outfile_fd = open(argv[3], O_WRONLY | O_CLOEXEC | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
-    checkError2(fds.outfile_fd, -1, "open error");
+        if(options.append_output == true)
+        {
+            fds.outfile_fd = open(argv[3], O_RDWR | O_CLOEXEC | O_CREAT, S_IRUSR | S_IWUSR);
+            checkError2(fds.outfile_fd, -1, "open error");
+            const off_t removed = recover_log_file(fds.outfile_fd);
+            if(removed > 0)
+            {
+                printf("dropped %lld bytes of a torn record at the end of %s\n", static_cast<long long int>(removed), argv[3]);
+            }
+        }
+        else
+        {
+            fds.outfile_fd = open(argv[3], O_WRONLY | O_CLOEXEC | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+            checkError2(fds.outfile_fd, -1, "open error");
+        }
+        log_writer.file_size = lseek(fds.outfile_fd, 0, SEEK_END);
+        checkError2(log_writer.file_size, static_cast<off_t>(-1), "lseek error");
+        log_writer.allocated_size = log_writer.file_size;
+        log_writer.preallocate = (options.preallocate_bytes > 0);
+        log_writer.quit = false;
+        if(options.realtime == true)
+        {
+            log_writer.pending.resize(std::max(options.sync_bytes * 2, static_cast<size_t>(64 * 1024) ) );
+            log_writer.pending.clear();
+        }
+        jitter_stats_init();
+        if(options.rollups == true)
+        {
+            init_rollups(argv[3]);
+        }
+        if(options.checkpoint_path != NULL)
+        {
+            init_checkpoint();
+        }
 
-    memset(&config, 0, sizeof(config));
-    checkError(tcgetattr(fds.serial_fd, &config), 0, "tcgetattr error");
+        memset(&config, 0, sizeof(config));
+        checkError(tcgetattr(fds.serial_fd, &config), 0, "tcgetattr error");
 
-    // 8 data bits, 1 stop bit, no parity
-    config.c_cflag &= static_cast<tcflag_t>(~(CSIZE | CSTOPB | PARENB));
-    config.c_cflag |= CS8;
+        // 8 data bits, 1 stop bit, no parity
+        config.c_cflag &= static_cast<tcflag_t>(~(CSIZE | CSTOPB | PARENB));
+        config.c_cflag |= CS8;
 
-    // don't map CR to NL or vice versa
-    config.c_iflag &= static_cast<tcflag_t>(~(ICRNL | INLCR));
+        // don't map CR to NL or vice versa
+        config.c_iflag &= static_cast<tcflag_t>(~(ICRNL | INLCR));
 
-    // set baud rate
-    checkError(cfsetispeed(&config, baud_rate), 0, "cfsetispeed error");
-    checkError(cfsetospeed(&config, baud_rate), 0, "cfsetospeed error");
+        // set baud rate
+        checkError(cfsetispeed(&config, baud_rate), 0, "cfsetispeed error");
+        checkError(cfsetospeed(&config, baud_rate), 0, "cfsetospeed error");
 
-    checkError(tcsetattr(fds.serial_fd, TCSANOW, &config), 0, "tcsetattr error");
+        checkError(tcsetattr(fds.serial_fd, TCSANOW, &config), 0, "tcsetattr error");
 
-    memset(&config2, 0, sizeof(config2));
-    checkError(tcgetattr(fds.serial_fd, &config2), 0, "tcgetattr error");
+        memset(&config2, 0, sizeof(config2));
+        checkError(tcgetattr(fds.serial_fd, &config2), 0, "tcgetattr error");
 
-    checkError(memcmp(&config, &config2, sizeof(config)), 0, "memcmp error"); 
+        checkError(memcmp(&config, &config2, sizeof(config)), 0, "memcmp error"); 
 
-    checkError(ioctl(fds.serial_fd, TIOCEXCL, NULL), 0, "ioctl error");
+        checkError(ioctl(fds.serial_fd, TIOCEXCL, NULL), 0, "ioctl error");
+    }
 
-    // set up shared memory regions
+    // set up shared memory regions, the fleet log first since a second
+    // drainer stops before it created the objects of its instance
+    if(options.fleet == true)
+    {
+        init_fleet_log();
+    }
     init_shared_memory();
+    if(options.attach == true)
+    {
+        attached_feed = live_feed_attach(instance.instance_index);
+        checkError2(attached_feed, static_cast<const LiveFeedHeader *>(NULL), "live_feed_attach error, is the daemon running?");
+        replayed = replay_output_file(argv[3]);
+    }
+    else
+    {
+        init_live_feed();
+    }
 
-    // set up graphical window
-    glutInit(&argc, argv);
-    glutSetOption(GLUT_MULTISAMPLE, SAMPLE_COUNT);
-    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
-    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_ALPHA | GLUT_DEPTH | GLUT_MULTISAMPLE);
-    glutInitWindowPosition(window_x, window_y);
-    glutInitWindowSize(window.window_width, window.window_height);
-    glutCreateWindow("Portacount window");
+    // set up graphical window, a headless daemon never connects to a display
+#ifndef GRAPH_HEADLESS
+    if(options.headless == false)
+    {
+        glutInit(&argc, argv);
+        glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+        glutInitWindowPosition(window_x, window_y);
+        glutInitWindowSize(window.window_width, window.window_height);
+        create_window("Portacount window");
+
+        init_graphics();
+        geometry.quit = false;
+        geometry.has_published = false;
+        geometry.published_sequence.store(0);
+        geometry_request();
+    }
+#else
+    (void)window_x;
+    (void)window_y;
+#endif
 
-    init_graphics();
+    init_stream_server();
 
-    std::thread serial_thread(read_serial_thread);
+    if(options.realtime == true)
+    {
+        // MCL_ONFAULT: the GL driver maps far more than it touches, so lock
+        // pages as they are used; the serial thread's buffers are already touched
+        checkError(mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT), 0, "mlockall error");
+    }
 
-    glutMainLoop();
+    std::thread output_thread;
+    if(options.attach == false)
+    {
+        output_thread = std::thread(log_thread);
+    }
+    std::thread model_thread(ingest_thread);
+#ifndef GRAPH_HEADLESS
+    std::thread frame_thread;
+    if(options.headless == false)
+    {
+        frame_thread = std::thread(geometry_thread);
+    }
+#endif
+    std::thread alarm_watch_thread;
+    if(alarm_enabled() == true)
+    {
+        init_alarms();
+        alarm_watch_thread = std::thread(alarm_thread);
+    }
+    std::thread server_thread;
+    if(stream_server_enabled() == true)
+    {
+        server_thread = std::thread(stream_thread);
+    }
+    std::thread fleet_record_thread;
+    if(options.fleet_record_path != NULL)
+    {
+        fleet_record_thread = std::thread(fleet_thread);
+    }
+    std::thread session_thread;
+    if(options.checkpoint_path != NULL)
+    {
+        session_thread = std::thread(checkpoint_thread);
+    }
+    std::thread serial_thread = (options.attach == true) ? std::thread(attach_thread, replayed) : std::thread(read_serial_thread);
 
+#ifndef GRAPH_HEADLESS
+    if(options.headless == true)
+    {
+        headless_loop();
+    }
+    else
+    {
+        glutMainLoop();
+        geometry_close(frame_thread);
+    }
+#else
+    headless_loop();
+#endif
     atomic_test_and_set(thread_info.quit, false, true);
     std::atomic_thread_fence(std::memory_order_seq_cst);
     serial_thread.join();
+    jitter_stats_report(stdout);
+    if(options.rollups == true)
+    {
+        rollup_flush();
+    }
+    ingest_close(model_thread);
+    if(options.checkpoint_path != NULL)
+    {
+        checkpoint_close(session_thread);
+    }
+    alarm_close(alarm_watch_thread);
+    if(ingest_queue.dropped.load() > 0 || ingest_queue.coalesced.load() > 0)
+    {
+        printf("ingest queue overload: %llu records dropped, %llu coalesced\n", ingest_queue.dropped.load(), ingest_queue.coalesced.load() );
+    }
+    if(options.attach == false)
+    {
+        log_writer_close(output_thread);
+    }
+    stream_server_close(server_thread);
+    if(options.rollups == true)
+    {
+        rollup_close();
+    }
 
+    if(options.attach == true)
+    {
+        // the shared memory of the instance stays with the daemon
+        live_feed_detach(attached_feed);
+        attached_feed = NULL;
+        return 0;
+    }
     checkError(close(fds.serial_fd), 0, "close error");
     checkError(close(fds.outfile_fd), 0, "close error");
+    remove_live_feed();
     remove_shared_memory();
+    if(options.fleet == true)
+    {
+        fleet_log_close(fleet_record_thread);
+    }
     return 0;
 }
+#endif
@@ -0,0 +1,57 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+// Stand-ins for the process-wide setup of graph's main, shared by the
+// programs that compile graph.cpp with GRAPH_NO_MAIN (bench.cpp, soak.cpp).
+
+namespace
+{
+    // The y-axis sync normally runs against the shared memory of all
+    // instances; here the blocks live in this process.
+    static void init_fake_instances(const unsigned int total_instances)
+    {
+        instance.total_instances = total_instances;
+        instance.instance_index = 0;
+        semaphore_ptrs = new sem_t*[total_instances];
+        shared_memory_ptrs = new SharedMemoryBuffer*[total_instances];
+        for(unsigned int i = 0; i < total_instances; i++)
+        {
+            semaphore_ptrs[i] = new sem_t;
+            checkError(sem_init(semaphore_ptrs[i], 0, 1), 0, "sem_init error");
+            shared_memory_ptrs[i] = new SharedMemoryBuffer();
+            shared_memory_ptrs[i]->valid = true;
+            shared_memory_ptrs[i]->mode = ModeType::FIT_TEST_MODE;
+            for(size_t channel = 0; channel < MAX_CHANNEL_COUNT; channel++)
+            {
+                shared_memory_ptrs[i]->axes[static_cast<size_t>(ModeType::FIT_TEST_MODE)][channel].y_axis_valid = true;
+                shared_memory_ptrs[i]->axes[static_cast<size_t>(ModeType::FIT_TEST_MODE)][channel].y_axis_min = -1.0 - static_cast<double>(i);
+                shared_memory_ptrs[i]->axes[static_cast<size_t>(ModeType::FIT_TEST_MODE)][channel].y_axis_max = 3.0 + static_cast<double>(i);
+            }
+        }
+    }
+
+    static void remove_fake_instances(void)
+    {
+        for(unsigned int i = 0; i < instance.total_instances; i++)
+        {
+            checkError(sem_destroy(semaphore_ptrs[i]), 0, "sem_destroy error");
+            delete semaphore_ptrs[i];
+            delete shared_memory_ptrs[i];
+        }
+        delete [] semaphore_ptrs;
+        semaphore_ptrs = NULL;
+        delete [] shared_memory_ptrs;
+        shared_memory_ptrs = NULL;
+    }
+
+    // the live feed in private memory instead of shared memory
+    static void init_private_live_feed(void)
+    {
+        void *const ptr = mmap(NULL, live_feed_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        checkError2(ptr, MAP_FAILED, "mmap error");
+        live_feed = static_cast<LiveFeedHeader *>(ptr);
+        live_feed_init(live_feed);
+    }
+}
+
+#endif
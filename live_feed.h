@@ -0,0 +1,291 @@
+#ifndef LIVE_FEED_H
+#define LIVE_FEED_H
+
+// Shared-memory feed of the parsed records of one graph instance.
+//
+// The object is named "<portacount_shm_prefix>_feed_<instance index>" and holds
+// a LiveFeedHeader followed by LIVE_FEED_CAPACITY slots. The instance is the
+// only writer; any number of local readers map it read-only and read the
+// records in place, so the writer never waits for a reader.
+//
+// Record n goes to slot n % LIVE_FEED_CAPACITY. The slot state is a sequence
+// lock: 2n + 1 while record n is being written and 2n + 2 once it is
+// complete, after which head is advanced to n + 1. A reader that falls more
+// than LIVE_FEED_CAPACITY records behind has been lapped; live_feed_read then
+// skips it forward to the oldest record still in the ring and counts the
+// records it missed. A reader that finds a slot rewritten under it retries,
+// which also ends up skipping forward.
+//
+// A writer that exits cleanly marks the feed closed and removes the object;
+// a restarted writer creates a new one, which readers have to attach to
+// again. live_feed_read reports the closed feed once every record is read.
+// A writer restarted after a crash reuses the object and reinitializes it
+// with a new epoch; readers notice the change and start over from the
+// beginning of the new feed.
+//
+// The header also carries the threshold alarm state of the instance:
+// alarm_active has bit (1 << LiveAlarmRule) set while that rule fails, and
+// alarm_count counts the alarms raised. The writer sets a bit before the
+// record that raised it is published.
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+
+// prefix of every shared memory object of graph
+static constexpr const char *const portacount_shm_prefix = "/Portacount_vyjcicyipdclbkthgcrppallfevgbjkk";
+static constexpr const uint32_t LIVE_FEED_MAGIC = 0x46434c50; // "PLCF"
+static constexpr const uint32_t LIVE_FEED_VERSION = 3;
+static constexpr const uint32_t LIVE_FEED_CAPACITY = 4096;
+static_assert( (LIVE_FEED_CAPACITY & (LIVE_FEED_CAPACITY - 1) ) == 0, "LIVE_FEED_CAPACITY must be a power of two");
+
+enum LiveAlarmRule : uint8_t
+{
+    LIVE_ALARM_AMBIENT_LOW = 0,     // ambient count below the protocol minimum
+    LIVE_ALARM_FIT_FACTOR_LOW = 1,  // fit factor below the pass level
+    LIVE_ALARM_RULE_COUNT = 2
+};
+
+struct LiveRecord
+{
+    uint64_t sequence;  // record number within the feed, from 0
+    double timestamp;   // CLOCK_MONOTONIC seconds when the last byte of the line arrived
+    double reading;     // value as reported by the instrument
+    double value;       // log10 of the reading, as plotted
+    uint8_t mode;       // 0 = count mode channel, 1 = fit-test mode channel
+    uint8_t channel;    // channel within the mode, bottom panel first
+    uint8_t flags;      // 0x01 zero clamped, 0x02 PASS, 0x04 FAIL
+    uint8_t reserved[5];
+};
+static_assert(sizeof(LiveRecord) == 40, "Unexpected LiveRecord size");
+
+struct alignas(64) LiveFeedSlot
+{
+    std::atomic<uint64_t> state;
+    LiveRecord record;
+};
+
+struct alignas(64) LiveFeedHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t record_size;
+    uint64_t epoch;                    // CLOCK_REALTIME nanoseconds when the writer initialized the feed
+    alignas(64) std::atomic<uint64_t> head; // records published so far
+    alignas(64) std::atomic<uint32_t> alarm_active;
+    std::atomic<uint32_t> alarm_count;
+    std::atomic<uint32_t> closed;      // 1: the writer has exited, no record follows
+};
+
+struct LiveFeedCursor
+{
+    uint64_t epoch;
+    uint64_t next;      // sequence of the next record to read
+    uint64_t lost;      // records overwritten before they could be read
+    bool closed;        // every record is read and the writer has exited
+};
+
+static inline int live_feed_name(char *const name, const size_t size, const unsigned int instance_index)
+{
+    return snprintf(name, size, "%s_feed_%u", portacount_shm_prefix, instance_index);
+}
+
+static inline size_t live_feed_size(void)
+{
+    return sizeof(LiveFeedHeader) + sizeof(LiveFeedSlot) * LIVE_FEED_CAPACITY;
+}
+
+static inline LiveFeedSlot *live_feed_slots(LiveFeedHeader *const header)
+{
+    return reinterpret_cast<LiveFeedSlot *>(header + 1);
+}
+
+static inline const LiveFeedSlot *live_feed_slots(const LiveFeedHeader *const header)
+{
+    return reinterpret_cast<const LiveFeedSlot *>(header + 1);
+}
+
+// writer side, on a zero-filled mapping of live_feed_size() bytes
+static inline void live_feed_init(LiveFeedHeader *const header)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header->version = LIVE_FEED_VERSION;
+    header->capacity = LIVE_FEED_CAPACITY;
+    header->record_size = sizeof(LiveRecord);
+    header->epoch = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+    header->head.store(0, std::memory_order_relaxed);
+    header->alarm_active.store(0, std::memory_order_relaxed);
+    header->alarm_count.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    LiveFeedSlot *const slots = live_feed_slots(header);
+    for(uint32_t i = 0; i < LIVE_FEED_CAPACITY; i++)
+    {
+        slots[i].state.store(0, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = LIVE_FEED_MAGIC;
+}
+
+// writer side, never blocks
+static inline void live_feed_publish(LiveFeedHeader *const header, const LiveRecord &record)
+{
+    const uint64_t sequence = header->head.load(std::memory_order_relaxed);
+    LiveFeedSlot &slot = live_feed_slots(header)[sequence & (LIVE_FEED_CAPACITY - 1)];
+    slot.state.store(sequence * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.record, &record, sizeof(LiveRecord) );
+    slot.record.sequence = sequence;
+    slot.state.store(sequence * 2 + 2, std::memory_order_release);
+    header->head.store(sequence + 1, std::memory_order_release);
+}
+
+// writer side, last call before the feed is unmapped and removed
+static inline void live_feed_close(LiveFeedHeader *const header)
+{
+    header->closed.store(1, std::memory_order_release);
+}
+
+// Maps the feed of an instance read-only. Returns NULL with errno set if it
+// does not exist (yet) or is not a feed of this version.
+static inline const LiveFeedHeader *live_feed_attach(const unsigned int instance_index)
+{
+    char name[250];
+    struct stat statbuf;
+
+    const int len = live_feed_name(name, sizeof(name), instance_index);
+    if(len < 0 || len >= static_cast<int>(sizeof(name) ) )
+    {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if(fd == -1)
+    {
+        return NULL;
+    }
+    if(fstat(fd, &statbuf) != 0 || statbuf.st_size != static_cast<off_t>(live_feed_size() ) )
+    {
+        close(fd);
+        errno = EPROTO;
+        return NULL;
+    }
+    void *const ptr = mmap(NULL, live_feed_size(), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(ptr == MAP_FAILED)
+    {
+        return NULL;
+    }
+    const LiveFeedHeader *const header = static_cast<const LiveFeedHeader *>(ptr);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(header->magic != LIVE_FEED_MAGIC || header->version != LIVE_FEED_VERSION || header->capacity != LIVE_FEED_CAPACITY || header->record_size != sizeof(LiveRecord) )
+    {
+        munmap(ptr, live_feed_size() );
+        errno = EPROTO;
+        return NULL;
+    }
+    return header;
+}
+
+static inline void live_feed_detach(const LiveFeedHeader *const header)
+{
+    munmap(const_cast<LiveFeedHeader *>(header), live_feed_size() );
+}
+
+// Start at the oldest record still in the ring.
+static inline void live_feed_seek_oldest(const LiveFeedHeader *const header, LiveFeedCursor *const cursor)
+{
+    const uint64_t head = header->head.load(std::memory_order_acquire);
+    cursor->epoch = header->epoch;
+    cursor->next = (head > LIVE_FEED_CAPACITY) ? (head - LIVE_FEED_CAPACITY) : 0;
+    cursor->lost = 0;
+    cursor->closed = false;
+}
+
+// Copies the next record to *record and returns true, or returns false if
+// the reader has caught up with the writer. cursor->closed is then set if
+// the writer has exited; the reader should detach and attach again.
+static inline bool live_feed_read(const LiveFeedHeader *const header, LiveFeedCursor *const cursor, LiveRecord *const record)
+{
+    for(;;)
+    {
+        if(cursor->epoch != header->epoch)
+        {
+            cursor->epoch = header->epoch;
+            cursor->next = 0;
+        }
+        // closed before head, so that no record published before the close is missed
+        const bool closed = (header->closed.load(std::memory_order_acquire) != 0);
+        const uint64_t head = header->head.load(std::memory_order_acquire);
+        if(cursor->next >= head)
+        {
+            cursor->closed = closed;
+            return false;
+        }
+        if(head - cursor->next > LIVE_FEED_CAPACITY)
+        {
+            cursor->lost += head - LIVE_FEED_CAPACITY - cursor->next;
+            cursor->next = head - LIVE_FEED_CAPACITY;
+        }
+        const LiveFeedSlot &slot = live_feed_slots(header)[cursor->next & (LIVE_FEED_CAPACITY - 1)];
+        const uint64_t state = slot.state.load(std::memory_order_acquire);
+        if(state != cursor->next * 2 + 2)
+        {
+            // lapped while reading head, the next head load skips forward
+            continue;
+        }
+        memcpy(record, &slot.record, sizeof(LiveRecord) );
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.state.load(std::memory_order_relaxed) != state)
+        {
+            continue;
+        }
+        cursor->next++;
+        return true;
+    }
+}
+
+// Stream framing used by the socket server of graph (--stream-socket,
+// --stream-port). Every frame is a fixed-size StreamFrame in host byte order.
+// A client first receives a HELLO frame, then RECORD frames. Records carry
+// their feed sequence number, so a gap in the sequence means that records
+// were dropped for a slow client.
+
+static constexpr const uint8_t STREAM_FRAME_VERSION = 1;
+
+enum StreamFrameType : uint8_t
+{
+    STREAM_FRAME_HELLO = 1,
+    STREAM_FRAME_RECORD = 2
+};
+
+struct StreamHello
+{
+    uint32_t instance_index;
+    uint32_t reserved;
+    uint64_t epoch;     // epoch of the live feed the records come from
+};
+
+struct StreamFrame
+{
+    uint8_t type;       // StreamFrameType
+    uint8_t version;    // STREAM_FRAME_VERSION
+    uint16_t length;    // bytes of payload used
+    uint32_t reserved;
+    union
+    {
+        StreamHello hello;
+        LiveRecord record;
+    } payload;
+};
+static_assert(sizeof(StreamFrame) == 48, "Unexpected StreamFrame size");
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT (static user-space tracing) probes of graph, provider "portacount".
+//
+// With <sys/sdt.h> (systemtap-sdt-dev, systemtap-sdt-devel) at build time
+// every probe is a single nop plus an ELF note, so a running graph can be
+// traced with bpftrace or perf without restarting it. Without the header
+// the probes compile to nothing. `readelf -n graph` lists the probes built in.
+//
+// Timestamps are CLOCK_MONOTONIC nanoseconds, the clock of bpftrace's nsecs.
+// Records are identified by their live feed sequence number.
+//
+//   serial_read(arrival_ns, bytes)           serial thread, read() returned data
+//   line_framed(arrival_ns, bytes)           serial thread, one line complete
+//   record_parsed(sequence, arrival_ns, mode, channel)
+//   record_enqueue(sequence, queue_depth)    ingest queue, after the push
+//   record_drop(sequence, coalesced)         ingest queue full, record dropped or averaged into another
+//   record_dequeue(sequence, queue_depth)    ingest thread, after the pop
+//   sync_wait(instance_index)                geometry thread, before waiting for a y-axis semaphore
+//   sync_acquire(instance_index)             semaphore taken
+//   sync_release(instance_index)
+//   frame_built(frame_sequence, newest_arrival_ns, build_ns)
+//   frame_swap(frame_sequence, newest_arrival_ns)   GL thread, after glutSwapBuffers
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PORTACOUNT_HAVE_SDT 1
+#endif
+#endif
+
+#ifdef PORTACOUNT_HAVE_SDT
+#define PORTACOUNT_PROBE1(name, a) DTRACE_PROBE1(portacount, name, a)
+#define PORTACOUNT_PROBE2(name, a, b) DTRACE_PROBE2(portacount, name, a, b)
+#define PORTACOUNT_PROBE3(name, a, b, c) DTRACE_PROBE3(portacount, name, a, b, c)
+#define PORTACOUNT_PROBE4(name, a, b, c, d) DTRACE_PROBE4(portacount, name, a, b, c, d)
+#else
+#define PORTACOUNT_PROBE1(name, a) do { (void)(a); } while(0)
+#define PORTACOUNT_PROBE2(name, a, b) do { (void)(a); (void)(b); } while(0)
+#define PORTACOUNT_PROBE3(name, a, b, c) do { (void)(a); (void)(b); (void)(c); } while(0)
+#define PORTACOUNT_PROBE4(name, a, b, c, d) do { (void)(a); (void)(b); (void)(c); (void)(d); } while(0)
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+// Rollup sidecar files of a graph output file (--rollups).
+//
+// For every tier graph keeps "<output_file>.rollup-<tier>", e.g.
+// "log.txt.rollup-1m": a RollupFileHeader followed by RollupRecords, one per
+// series and bucket. A bucket covers [start, start + bucket_seconds) of
+// CLOCK_REALTIME, aligned to multiples of bucket_seconds, and summarizes the
+// readings (as reported by the instrument, not log10) of the records whose
+// arrival fell into it. The arrival times in the output file are
+// CLOCK_MONOTONIC; graph converts them with the offset between the clocks
+// taken at startup.
+//
+// A bucket is written once the next record of its series falls into a later
+// bucket, or at exit. Records of different series are therefore not strictly
+// ordered by start, and after a restart with --append the same bucket of a
+// series can appear twice (partial before, rest after); merge those by
+// taking the min of min, max of max and the count-weighted mean.
+
+#include <stdint.h>
+
+static constexpr const uint32_t ROLLUP_MAGIC = 0x52434c50; // "PLCR"
+static constexpr const uint32_t ROLLUP_VERSION = 1;
+static constexpr const size_t ROLLUP_TIER_COUNT = 4;
+static constexpr const uint32_t rollup_tier_seconds[ROLLUP_TIER_COUNT] = {1, 10, 60, 3600};
+static constexpr const char *const rollup_tier_names[ROLLUP_TIER_COUNT] = {"1s", "10s", "1m", "1h"};
+
+struct RollupFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t bucket_seconds;
+};
+static_assert(sizeof(RollupFileHeader) == 16, "Unexpected RollupFileHeader size");
+
+struct RollupRecord
+{
+    int64_t start;      // CLOCK_REALTIME seconds
+    float min;
+    float max;
+    float mean;
+    uint32_t count;     // records in the bucket
+    uint8_t mode;       // as in LiveRecord
+    uint8_t channel;
+    uint8_t reserved[6];
+};
+static_assert(sizeof(RollupRecord) == 32, "Unexpected RollupRecord size");
+
+#endif
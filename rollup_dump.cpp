@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include "rollup.h"
+
+// Prints a rollup sidecar file of graph as CSV, see rollup.h. Optional
+// CLOCK_REALTIME bounds in seconds select the buckets that start in
+// [from, to).
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Need more arguments: <rollup_file> [from_seconds [to_seconds]]\n");
+        return 1;
+    }
+    const int64_t from = (argc > 2) ? strtoll(argv[2], NULL, 10) : INT64_MIN;
+    const int64_t to = (argc > 3) ? strtoll(argv[3], NULL, 10) : INT64_MAX;
+
+    FILE *const file = fopen(argv[1], "rb");
+    if(file == NULL)
+    {
+        perror("fopen error");
+        return 1;
+    }
+    RollupFileHeader header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != ROLLUP_MAGIC || header.version != ROLLUP_VERSION ||
+        header.record_size != sizeof(RollupRecord) )
+    {
+        fprintf(stderr, "%s is not a rollup file of this version\n", argv[1]);
+        return 1;
+    }
+
+    static const char *const mode_names[] = {"count", "fit-test"};
+    RollupRecord record;
+    printf("# %" PRIu32 " s buckets\nstart,start_utc,mode,channel,min,max,mean,count\n", header.bucket_seconds);
+    while(fread(&record, sizeof(record), 1, file) == 1)
+    {
+        if(record.start < from || record.start >= to || record.mode > 1)
+        {
+            continue;
+        }
+        char start_utc[32];
+        const time_t start = static_cast<time_t>(record.start);
+        struct tm tm;
+        strftime(start_utc, sizeof(start_utc), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&start, &tm) );
+        printf("%" PRId64 ",%s,%s,%u,%g,%g,%g,%" PRIu32 "\n", record.start, start_utc, mode_names[record.mode], static_cast<unsigned int>(record.channel),
+            static_cast<double>(record.min), static_cast<double>(record.max), static_cast<double>(record.mean), record.count);
+    }
+    fclose(file);
+    return 0;
+}
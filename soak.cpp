@@ -0,0 +1,508 @@
+// Soak test for graph. The whole program is compiled into this translation
+// unit and driven by a simulated instrument on a pseudo-terminal at an
+// accelerated rate, with an operator that keeps clearing the history, for the
+// equivalent of days of acquisition. Memory, file descriptors, queue depth
+// and frame latency are sampled along the way and checked against bounds.
+#define GRAPH_NO_MAIN
+#include "graph.cpp"
+#include "harness.h"
+
+#include <dirent.h>
+#include <malloc.h>
+
+namespace
+{
+    struct SoakOptions
+    {
+        double simulated_days;
+        unsigned int rate;               // records per second
+        unsigned int clear_every;        // records between 'x' presses
+        unsigned int sample_ms;
+        unsigned int warmup_clears;      // clear cycles that set the memory baseline
+        long int max_rss_growth_kb;
+        long int max_heap_growth_kb;
+        long int max_fd_growth;
+        size_t max_queue;                // records
+        double max_frame_ms;
+        double max_behind_ms;
+        const char *output_path;         // NULL: stdout
+    };
+    static SoakOptions soak_options = {
+        .simulated_days = 1.0,
+        .rate = 2000,
+        .clear_every = 3600,
+        .sample_ms = 1000,
+        .warmup_clears = 3,
+        .max_rss_growth_kb = 4096,
+        .max_heap_growth_kb = 1024,
+        .max_fd_growth = 0,
+        .max_queue = 1024,
+        .max_frame_ms = 50.0,
+        .max_behind_ms = 1000.0,
+        .output_path = NULL
+    };
+
+    // one simulated second per record, as the instrument sends about one a second
+    static constexpr const double SIMULATED_SECONDS_PER_RECORD = 1.0;
+    static constexpr const unsigned int WRITER_BATCH_MS = 10;
+    static constexpr const unsigned int GUI_POLL_MS = 20;
+
+    // the instrument end of the pseudo-terminal
+    struct SimulatedInstrument
+    {
+        int master_fd;
+        unsigned long long total_records;
+        std::atomic<unsigned long long> sent;
+        std::atomic<bool> quit;
+    };
+    static SimulatedInstrument instrument;
+
+    struct SoakSample
+    {
+        long int rss_kb;
+        long int heap_kb;            // obtained from the system, in use or not
+        long int heap_in_use_kb;
+        long int heap_free_kb;       // held by the allocator but unused: fragmentation
+        long int fds;
+        size_t queue;
+        size_t log_pending;
+        double behind_ms;
+    };
+
+    // Record number n of the simulated stream. Count mode and fit-test mode
+    // records are interleaved so both stores grow.
+    static int simulated_line(const unsigned long long n, char *const buf, const size_t size)
+    {
+        const double t = static_cast<double>(n);
+        const double concentration = 1000.0 * (1.5 + sin(t * 0.01) );
+        switch(n % 4)
+        {
+            case 0:
+                return snprintf(buf, size, "Conc. %.2f #/cc\r\n", concentration);
+            case 1:
+                return snprintf(buf, size, "Ambient %.1f #/cc\r\n", concentration * 2.0);
+            case 2:
+                return snprintf(buf, size, "Mask %.3f #/cc\r\n", concentration / 150.0);
+            default:
+            {
+                const double fit_factor = 300.0 * (1.0 + 0.5 * sin(t * 0.003) );
+                return snprintf(buf, size, "FF %llu %.0f %s\r\n", n / 4 % 100, fit_factor, (fit_factor >= 100.0) ? "PASS" : "FAIL");
+            }
+        }
+    }
+
+    // writes options.rate records per second in WRITER_BATCH_MS batches
+    static void instrument_thread(void)
+    {
+        const unsigned long long per_batch = std::max(1ULL, static_cast<unsigned long long>(soak_options.rate) * WRITER_BATCH_MS / 1000);
+        std::vector<char> batch;
+        char line[64];
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+        while(instrument.quit.load() == false && instrument.sent.load() < instrument.total_records)
+        {
+            const unsigned long long begin = instrument.sent.load();
+            const unsigned long long end = std::min(begin + per_batch, instrument.total_records);
+            batch.clear();
+            for(unsigned long long n = begin; n < end; n++)
+            {
+                const int len = simulated_line(n, line, sizeof(line) );
+                checkError3(len, static_cast<int>(sizeof(line) - 1), "snprintf error");
+                batch.insert(batch.end(), line, line + len);
+            }
+            // blocks while the serial thread is behind, where a real line would overrun
+            writeFully(instrument.master_fd, batch.data(), batch.size() );
+            instrument.sent.store(end);
+
+            next += std::chrono::milliseconds(WRITER_BATCH_MS);
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    // Opens a pseudo-terminal in raw mode as fds.serial_fd, so the real
+    // serial thread reads the simulated instrument.
+    static void init_instrument(void)
+    {
+        termios config;
+
+        instrument.master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+        checkError2(instrument.master_fd, -1, "posix_openpt error");
+        checkError(grantpt(instrument.master_fd), 0, "grantpt error");
+        checkError(unlockpt(instrument.master_fd), 0, "unlockpt error");
+        const char *const name = ptsname(instrument.master_fd);
+        checkError2(name, static_cast<const char *>(NULL), "ptsname error");
+        fds.serial_fd = open(name, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        checkError2(fds.serial_fd, -1, "open error");
+
+        memset(&config, 0, sizeof(config) );
+        checkError(tcgetattr(fds.serial_fd, &config), 0, "tcgetattr error");
+        cfmakeraw(&config);
+        checkError(tcsetattr(fds.serial_fd, TCSANOW, &config), 0, "tcsetattr error");
+
+        instrument.total_records = static_cast<unsigned long long>(soak_options.simulated_days * 86400.0 / SIMULATED_SECONDS_PER_RECORD);
+        instrument.sent.store(0);
+        instrument.quit.store(false);
+    }
+
+    static long int open_fd_count(void)
+    {
+        DIR *const dir = opendir("/proc/self/fd");
+        checkError2(dir, static_cast<DIR *>(NULL), "opendir error");
+        long int count = 0;
+        while(const dirent *const entry = readdir(dir) )
+        {
+            if(entry->d_name[0] != '.')
+            {
+                count++;
+            }
+        }
+        checkError(closedir(dir), 0, "closedir error");
+        // not counting the descriptor of dir itself
+        return count - 1;
+    }
+
+    static long int rss_kb(void)
+    {
+        unsigned long int pages, resident;
+        FILE *const file = fopen("/proc/self/statm", "r");
+        checkError2(file, static_cast<FILE *>(NULL), "fopen error");
+        checkError(fscanf(file, "%lu %lu", &pages, &resident), 2, "fscanf error");
+        checkError(fclose(file), 0, "fclose error");
+        return static_cast<long int>(resident * static_cast<unsigned long int>(sysconf(_SC_PAGESIZE) ) / 1024);
+    }
+
+    static SoakSample take_sample(void)
+    {
+        SoakSample sample;
+        const struct mallinfo2 info = mallinfo2();
+
+        sample.rss_kb = rss_kb();
+        sample.heap_kb = static_cast<long int>( (info.arena + info.hblkhd) / 1024);
+        sample.heap_in_use_kb = static_cast<long int>( (info.uordblks + info.hblkhd) / 1024);
+        sample.heap_free_kb = static_cast<long int>(info.fordblks / 1024);
+        sample.fds = open_fd_count();
+        {
+            const std::lock_guard<std::mutex> lock_mutex(ingest_queue.queue_mutex);
+            sample.queue = ingest_queue.record_queue.size();
+        }
+        {
+            const std::lock_guard<std::mutex> lock_mutex(log_writer.mutex);
+            sample.log_pending = log_writer.pending.size();
+        }
+        const double pending_since = snapshots.pending_since.load(std::memory_order_relaxed);
+        sample.behind_ms = (pending_since > 0.0) ? std::max(0.0, (monotonic_seconds() - pending_since) * 1000.0) : 0.0;
+        return sample;
+    }
+
+    // what a user at the window would do: 'x' every clear_every records,
+    // switching between 'c' and 'f', and zooming in halfway through a cycle
+    static void simulated_operator(const unsigned long long clears, const bool halfway)
+    {
+        if(halfway == true)
+        {
+            const std::pair<ViewState *, double> view = current_view();
+            zoom_view(*view.first, view.second, 0.5, 1.0 / ZOOM_STEP);
+            geometry_request();
+            return;
+        }
+        views[static_cast<size_t>(mode)].zoomed = false;
+        snapshots.reset_requested[static_cast<size_t>(mode)].store(true);
+        ingest_queue.wakeup.notify_one();
+        mode = (clears % 2 == 0) ? ModeType::FIT_TEST_MODE : ModeType::COUNT_MODE;
+        geometry_request();
+    }
+
+    // the GL thread's part of display() without GL, or display() itself when there is a window
+    static double soak_frame(const bool has_window)
+    {
+        double build_seconds = 0.0;
+        if(has_window == true)
+        {
+            display();
+            glFinish();
+            build_seconds = geometry.front.build_seconds;
+        }
+        else
+        {
+            const std::lock_guard<std::mutex> lock_mutex(geometry.mutex);
+            if(geometry.has_published == true)
+            {
+                std::swap(geometry.front, geometry.published);
+                geometry.has_published = false;
+                build_seconds = geometry.front.build_seconds;
+            }
+        }
+        drawn_sequence = geometry.front.sequence;
+        return build_seconds;
+    }
+
+    // the instrument is done and everything it sent is in the active snapshot
+    static bool soak_drained(void)
+    {
+        if(instrument.sent.load() < instrument.total_records)
+        {
+            return false;
+        }
+        const std::lock_guard<std::mutex> lock_mutex(ingest_queue.queue_mutex);
+        return ingest_queue.record_queue.empty() == true && snapshots.pending_since.load(std::memory_order_relaxed) == 0.0;
+    }
+
+    static bool check_bound(const bool exceeded, const char *const what, const double value, const double bound)
+    {
+        if(exceeded == true)
+        {
+            fprintf(stderr, "soak: %s %g exceeds the bound of %g\n", what, value, bound);
+        }
+        return exceeded;
+    }
+
+    static void parse_soak_options(const int argc, char *const argv[], std::vector<char *> &graph_args)
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            const char *value;
+            if( (value = option_value(argv[i], "--simulated-days") ) != NULL)
+            {
+                soak_options.simulated_days = parse_double_option(value, 0.001, 3650.0, "simulated-days out of range");
+            }
+            else if( (value = option_value(argv[i], "--rate") ) != NULL)
+            {
+                soak_options.rate = static_cast<unsigned int>(parse_long_option(value, 1, 1000000, "rate out of range") );
+            }
+            else if( (value = option_value(argv[i], "--clear-every") ) != NULL)
+            {
+                soak_options.clear_every = static_cast<unsigned int>(parse_long_option(value, 2, 1000000000, "clear-every out of range") );
+            }
+            else if( (value = option_value(argv[i], "--sample-ms") ) != NULL)
+            {
+                soak_options.sample_ms = static_cast<unsigned int>(parse_long_option(value, GUI_POLL_MS, 3600000, "sample-ms out of range") );
+            }
+            else if( (value = option_value(argv[i], "--warmup-clears") ) != NULL)
+            {
+                soak_options.warmup_clears = static_cast<unsigned int>(parse_long_option(value, 1, 1000000, "warmup-clears out of range") );
+            }
+            else if( (value = option_value(argv[i], "--max-rss-growth-kb") ) != NULL)
+            {
+                soak_options.max_rss_growth_kb = parse_long_option(value, 0, 1L << 30, "max-rss-growth-kb out of range");
+            }
+            else if( (value = option_value(argv[i], "--max-heap-growth-kb") ) != NULL)
+            {
+                soak_options.max_heap_growth_kb = parse_long_option(value, 0, 1L << 30, "max-heap-growth-kb out of range");
+            }
+            else if( (value = option_value(argv[i], "--max-fd-growth") ) != NULL)
+            {
+                soak_options.max_fd_growth = parse_long_option(value, 0, 1000000, "max-fd-growth out of range");
+            }
+            else if( (value = option_value(argv[i], "--max-queue") ) != NULL)
+            {
+                soak_options.max_queue = static_cast<size_t>(parse_long_option(value, 0, 1L << 30, "max-queue out of range") );
+            }
+            else if( (value = option_value(argv[i], "--max-frame-ms") ) != NULL)
+            {
+                soak_options.max_frame_ms = parse_double_option(value, 0.0, 1e6, "max-frame-ms out of range");
+            }
+            else if( (value = option_value(argv[i], "--max-behind-ms") ) != NULL)
+            {
+                soak_options.max_behind_ms = parse_double_option(value, 0.0, 1e9, "max-behind-ms out of range");
+            }
+            else if( (value = option_value(argv[i], "--output") ) != NULL)
+            {
+                soak_options.output_path = value;
+            }
+            else
+            {
+                // everything else is an option of graph itself
+                graph_args.push_back(argv[i]);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<char *> graph_args;
+    parse_soak_options(argc, argv, graph_args);
+    parse_options(static_cast<int>(graph_args.size() ), graph_args.data(), 0);
+
+    // mallinfo2 only covers the main arena, so keep every thread on it
+    checkError(mallopt(M_ARENA_MAX, 1), 1, "mallopt error");
+
+    // the records graph echoes to stdout would drown the report
+    FILE *report;
+    if(soak_options.output_path != NULL)
+    {
+        report = fopen(soak_options.output_path, "w");
+        checkError2(report, static_cast<FILE *>(NULL), "fopen error");
+    }
+    else
+    {
+        const int report_fd = dup(STDOUT_FILENO);
+        checkError2(report_fd, -1, "dup error");
+        report = fdopen(report_fd, "w");
+        checkError2(report, static_cast<FILE *>(NULL), "fdopen error");
+    }
+    checkError2(freopen("/dev/null", "w", stdout), static_cast<FILE *>(NULL), "freopen error");
+
+    snapshots_init();
+    ingest_queue.quit = false;
+    ingest_queue.dropped.store(0);
+    ingest_queue.coalesced.store(0);
+    init_fake_instances(1);
+    init_private_live_feed();
+    init_instrument();
+
+    char log_path[] = "/tmp/graph_soak_XXXXXX";
+    fds.outfile_fd = mkostemp(log_path, O_CLOEXEC);
+    checkError2(fds.outfile_fd, -1, "mkostemp error");
+    log_writer.file_size = 0;
+    log_writer.allocated_size = 0;
+    log_writer.preallocate = (options.preallocate_bytes > 0);
+    log_writer.quit = false;
+    if(options.realtime == true)
+    {
+        log_writer.pending.resize(std::max(options.sync_bytes * 2, static_cast<size_t>(64 * 1024) ) );
+        log_writer.pending.clear();
+    }
+    jitter_stats_init();
+    if(options.rollups == true)
+    {
+        init_rollups(log_path);
+    }
+
+    const bool has_window = (getenv("DISPLAY") != NULL);
+    if(has_window == true)
+    {
+        glutInit(&argc, argv);
+        glutInitWindowSize(window.window_width, window.window_height);
+        create_window("Portacount soak");
+        init_graphics();
+    }
+    geometry.quit = false;
+    geometry.has_published = false;
+    geometry.published_sequence.store(0);
+    geometry_request();
+
+    init_stream_server();
+    if(options.realtime == true)
+    {
+        checkError(mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT), 0, "mlockall error");
+    }
+
+    std::thread output_thread(log_thread);
+    std::thread model_thread(ingest_thread);
+    std::thread frame_thread(geometry_thread);
+    std::thread alarm_watch_thread;
+    if(alarm_enabled() == true)
+    {
+        init_alarms();
+        alarm_watch_thread = std::thread(alarm_thread);
+    }
+    std::thread server_thread;
+    if(stream_server_enabled() == true)
+    {
+        server_thread = std::thread(stream_thread);
+    }
+    std::thread serial_thread(read_serial_thread);
+    // counted after every thread is up, so only descriptors leaked later count as growth
+    const long int fds_baseline = open_fd_count();
+    std::thread writer_thread(instrument_thread);
+
+    fprintf(report, "elapsed_s,records,simulated_days,clears,rss_kb,heap_kb,heap_in_use_kb,heap_free_kb,fds,queue,log_pending_bytes,behind_ms,frame_ms,dropped,coalesced\n");
+
+    // Memory is compared at the same point of every clear cycle, just before
+    // the 'x': the history then has the same size, so anything more than in
+    // the warm-up cycles is a leak or fragmentation that clears do not undo.
+    const double begin = monotonic_seconds();
+    double next_sample = begin + soak_options.sample_ms / 1000.0;
+    double frame_ms = 0.0;
+    unsigned long long clears = 0;
+    unsigned long long next_halfway = soak_options.clear_every / 2;
+    long int baseline_rss_kb = 0;
+    long int baseline_heap_kb = 0;
+    bool failed = false;
+
+    while(failed == false && soak_drained() == false)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(GUI_POLL_MS) );
+        frame_ms = std::max(frame_ms, soak_frame(has_window) * 1000.0);
+
+        const unsigned long long sent = instrument.sent.load();
+        if(sent >= next_halfway)
+        {
+            simulated_operator(clears, true);
+            next_halfway += soak_options.clear_every;
+        }
+        if(sent >= (clears + 1) * soak_options.clear_every)
+        {
+            const SoakSample sample = take_sample();
+            simulated_operator(clears, false);
+            clears++;
+            if(clears <= soak_options.warmup_clears)
+            {
+                baseline_rss_kb = std::max(baseline_rss_kb, sample.rss_kb);
+                baseline_heap_kb = std::max(baseline_heap_kb, sample.heap_kb);
+            }
+            else
+            {
+                failed |= check_bound(sample.rss_kb - baseline_rss_kb > soak_options.max_rss_growth_kb, "RSS growth (kB)",
+                    static_cast<double>(sample.rss_kb - baseline_rss_kb), static_cast<double>(soak_options.max_rss_growth_kb) );
+                failed |= check_bound(sample.heap_kb - baseline_heap_kb > soak_options.max_heap_growth_kb, "heap growth (kB)",
+                    static_cast<double>(sample.heap_kb - baseline_heap_kb), static_cast<double>(soak_options.max_heap_growth_kb) );
+            }
+        }
+
+        const double now = monotonic_seconds();
+        if(now >= next_sample)
+        {
+            const SoakSample sample = take_sample();
+            fprintf(report, "%.1f,%llu,%.3f,%llu,%ld,%ld,%ld,%ld,%ld,%zu,%zu,%.1f,%.2f,%llu,%llu\n", now - begin, sent,
+                static_cast<double>(sent) * SIMULATED_SECONDS_PER_RECORD / 86400.0, clears, sample.rss_kb, sample.heap_kb,
+                sample.heap_in_use_kb, sample.heap_free_kb, sample.fds, sample.queue, sample.log_pending, sample.behind_ms, frame_ms,
+                ingest_queue.dropped.load(), ingest_queue.coalesced.load() );
+            fflush(report);
+            failed |= check_bound(sample.fds - fds_baseline > soak_options.max_fd_growth, "file descriptor growth",
+                static_cast<double>(sample.fds - fds_baseline), static_cast<double>(soak_options.max_fd_growth) );
+            failed |= check_bound(sample.queue > soak_options.max_queue, "queue depth", static_cast<double>(sample.queue), static_cast<double>(soak_options.max_queue) );
+            failed |= check_bound(frame_ms > soak_options.max_frame_ms, "frame time (ms)", frame_ms, soak_options.max_frame_ms);
+            failed |= check_bound(sample.behind_ms > soak_options.max_behind_ms, "behind (ms)", sample.behind_ms, soak_options.max_behind_ms);
+            frame_ms = 0.0;
+            next_sample = now + soak_options.sample_ms / 1000.0;
+        }
+    }
+
+    instrument.quit.store(true);
+    writer_thread.join();
+    geometry_close(frame_thread);
+    atomic_test_and_set(thread_info.quit, false, true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    serial_thread.join();
+    if(options.rollups == true)
+    {
+        rollup_flush();
+    }
+    ingest_close(model_thread);
+    alarm_close(alarm_watch_thread);
+    log_writer_close(output_thread);
+    stream_server_close(server_thread);
+    if(options.rollups == true)
+    {
+        rollup_close();
+        for(size_t tier = 0; tier < ROLLUP_TIER_COUNT; tier++)
+        {
+            char name[4096];
+            rollup_file_name(name, sizeof(name), log_path, tier);
+            checkError(unlink(name), 0, "unlink error");
+        }
+    }
+
+    checkError(close(instrument.master_fd), 0, "close error");
+    checkError(close(fds.serial_fd), 0, "close error");
+    checkError(close(fds.outfile_fd), 0, "close error");
+    checkError(unlink(log_path), 0, "unlink error");
+    remove_fake_instances();
+
+    fprintf(report, "# %llu records, %llu clears, baseline RSS %ld kB, heap %ld kB: %s\n", instrument.sent.load(), clears,
+        baseline_rss_kb, baseline_heap_kb, (failed == true) ? "FAILED" : "passed");
+    checkError(fclose(report), 0, "fclose error");
+    return (failed == true) ? 1 : 0;
+}